@@ -13,29 +13,166 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <limits>
 #include <atomic>
 #include <type_traits>
+#include <new>
+#include <utility>
 
 namespace jnk0le
 {
+	namespace detail
+	{
+		/*!
+		 * \brief Index and element storage of Ringbuffer, with compile time capacity
+		 *
+		 * Elements are kept in uninitialized storage, objects are constructed on insertion and destroyed on removal.
+		 * Storage is trivially destructible unless T requires destructor to be called on leftover elements.
+		 */
+		template<typename T, size_t buffer_size, size_t cacheline_size, typename index_t,
+			bool trivially_destructible = std::is_trivially_destructible<T>::value>
+		class RingbufferStorage
+		{
+		public:
+			/*!
+			 * \brief Get capacity of the buffer
+			 * \return Maximum number of elements that can be stored
+			 */
+			constexpr static size_t capacity(void) {
+				return buffer_size;
+			}
+
+		protected:
+			RingbufferStorage()
+				: head(0), cached_tail(0), staged_head(0), tail(0), cached_head(0), staged_tail(0), release_interval(1) {}
+			RingbufferStorage(int dummy) { (void)(dummy); }
+
+			T* slot(index_t index) {
+				return reinterpret_cast<T*>(&data_buff[index & buffer_mask]);
+			}
+
+			constexpr static index_t buffer_mask = buffer_size-1; //!< bitwise mask for a given buffer size
+
+			alignas(cacheline_size) std::atomic<index_t> head; //!< head index
+			alignas(cacheline_size) index_t cached_tail; //!< producer side copy of tail index
+			index_t staged_head; //!< producer side head index, including elements not yet published
+			alignas(cacheline_size) std::atomic<index_t> tail; //!< tail index
+			alignas(cacheline_size) index_t cached_head; //!< consumer side copy of head index
+			index_t staged_tail; //!< consumer side tail index, including elements not yet released
+			index_t release_interval; //!< number of consumed elements after which tail is released
+
+			// put buffer after variables so everything can be reached with short offsets
+			alignas(cacheline_size) typename std::aligned_storage<sizeof(T), alignof(T)>::type
+				data_buff[buffer_size]; //!< actual buffer, uninitialized
+
+			// let's assert that no UB will be compiled in
+			static_assert((buffer_size & buffer_mask) == 0, "buffer size is not a power of 2");
+			static_assert(buffer_mask <= ((std::numeric_limits<index_t>::max)() >> 1),
+				"buffer size is too large for a given indexing type (maximum size for n-bit type is 2^(n-1))");
+		};
+
+		/*!
+		 * \brief Index and element storage of Ringbuffer, with capacity and memory given at runtime
+		 *
+		 * Elements are kept in externally supplied memory, objects are constructed on insertion and destroyed on
+		 * removal.
+		 */
+		template<typename T, size_t cacheline_size, typename index_t>
+		class RingbufferStorage<T, 0, cacheline_size, index_t, true>
+		{
+		public:
+			/*!
+			 * \brief Get capacity of the buffer
+			 * \return Maximum number of elements that can be stored
+			 */
+			size_t capacity(void) const {
+				return static_cast<size_t>(buffer_mask) + 1;
+			}
+
+		protected:
+			RingbufferStorage(void* buffer, size_t size)
+				: head(0), cached_tail(0), staged_head(0), tail(0), cached_head(0), staged_tail(0), release_interval(1),
+				  data_buff(static_cast<T*>(buffer)), buffer_mask(sizeToMask(size)) {}
+
+			T* slot(index_t index) {
+				return &data_buff[index & buffer_mask];
+			}
+
+			static index_t sizeToMask(size_t size) {
+				index_t mask = 0;
+
+				// round down to power of 2, maximum size for n-bit indexing type is 2^(n-1)
+				while((size >> 1) > mask && mask < ((std::numeric_limits<index_t>::max)() >> 1))
+					mask = (mask << 1) | 1;
+
+				return mask;
+			}
+
+			alignas(cacheline_size) std::atomic<index_t> head; //!< head index
+			alignas(cacheline_size) index_t cached_tail; //!< producer side copy of tail index
+			index_t staged_head; //!< producer side head index, including elements not yet published
+			alignas(cacheline_size) std::atomic<index_t> tail; //!< tail index
+			alignas(cacheline_size) index_t cached_head; //!< consumer side copy of head index
+			index_t staged_tail; //!< consumer side tail index, including elements not yet released
+			index_t release_interval; //!< number of consumed elements after which tail is released
+
+			// read only after construction, shared by both sides
+			alignas(cacheline_size) T* const data_buff; //!< externally supplied buffer, uninitialized
+			const index_t buffer_mask; //!< bitwise mask for a given buffer size
+		};
+
+		template<typename T, size_t buffer_size, size_t cacheline_size, typename index_t>
+		class RingbufferStorage<T, buffer_size, cacheline_size, index_t, false>
+			: public RingbufferStorage<T, buffer_size, cacheline_size, index_t, true>
+		{
+			typedef RingbufferStorage<T, buffer_size, cacheline_size, index_t, true> base;
+
+		protected:
+			RingbufferStorage() {}
+			RingbufferStorage(int dummy) : base(dummy) {}
+			RingbufferStorage(void* buffer, size_t size) : base(buffer, size) {}
+
+			~RingbufferStorage() {
+				// elements consumed but not released yet are still alive (moved from)
+				index_t tmp_head = this->staged_head; // including not published elements
+
+				for(index_t i = this->tail.load(std::memory_order_relaxed); i != tmp_head; i++)
+					this->slot(i)->~T();
+			}
+		};
+	} // namespace detail
+
 	/*!
 	 * \brief Lock free, with no wasted slots ringbuffer implementation
 	 *
 	 * \tparam T Type of buffered elements
-	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2. If 0, capacity and storage are given at runtime
+	 * (see ExternalRingbuffer)
 	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
 	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
 	 * \tparam index_t Type of array indexing type. Serves also as placeholder for future implementations.
 	 */
 	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
-	class Ringbuffer
+	class Ringbuffer : private detail::RingbufferStorage<T, buffer_size, cacheline_size, index_t>
 	{
+		typedef detail::RingbufferStorage<T, buffer_size, cacheline_size, index_t> storage;
+
 	public:
+		using storage::capacity;
+
+		/*!
+		 * \brief Contiguous block of elements inside internal buffer
+		 */
+		struct span {
+			T* data; //!< pointer to first element of the block
+			size_t size; //!< number of elements in the block
+		};
+
 		/*!
 		 * \brief Default constructor, will initialize head and tail indexes
 		 */
-		Ringbuffer() : head(0), tail(0) {}
+		Ringbuffer() {}
 
 		/*!
 		 * \brief Special case constructor to premature out unnecessary initialization code when object is
@@ -44,23 +181,47 @@ namespace jnk0le
 		 * explicitly cleared before use
 		 * \param dummy Ignored
 		 */
-		Ringbuffer(int dummy) { (void)(dummy); }
+		Ringbuffer(int dummy) : storage(dummy) {}
+
+		/*!
+		 * \brief Constructor of runtime capacity buffer (buffer_size == 0), placed in externally supplied memory
+		 *
+		 * Capacity is rounded down to power of 2, so the indexes can still be masked. Memory is not owned by the
+		 * object and is treated as uninitialized storage
+		 *
+		 * \param buffer Pointer to memory suitably aligned for T, of at least size elements
+		 * \param size Number of elements that fit into given memory, must not be 0
+		 */
+		Ringbuffer(void* buffer, size_t size) : storage(buffer, size) {}
 
 		/*!
 		 * \brief Clear buffer from producer side
 		 * \warning function may return without performing any action if consumer tries to read data at the same time
+		 * \warning available only for trivially destructible T, as consumer may access the same elements in the meantime
 		 */
 		void producerClear(void) {
+			static_assert(std::is_trivially_destructible<T>::value,
+				"producerClear() can't destroy elements that consumer may access, use consumerClear() instead");
+
 			// head modification will lead to underflow if cleared during consumer read
 			// doing this properly with CAS is not possible without modifying the consumer code
-			consumerClear();
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+
+			staged_head = tmp_head; // drop elements that were not published yet
+			cached_tail = tmp_head;
+			tail.store(tmp_head, index_release_barrier);
 		}
 
 		/*!
 		 * \brief Clear buffer from consumer side
 		 */
 		void consumerClear(void) {
-			tail.store(head.load(std::memory_order_relaxed), std::memory_order_relaxed);
+			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+			cached_head = head.load(index_acquire_barrier);
+
+			destroy(tmp_tail, static_cast<index_t>(cached_head - tmp_tail));
+			staged_tail = cached_head;
+			tail.store(cached_head, index_release_barrier);
 		}
 
 		/*!
@@ -81,60 +242,133 @@ namespace jnk0le
 
 		/*!
 		 * \brief Check how many elements can be read from the buffer
-		 * \return Number of elements that can be read
+		 * \return Number of elements that can be read, including consumed ones that were not released yet
 		 */
 		index_t readAvailable(void) const {
 			return head.load(index_acquire_barrier) - tail.load(std::memory_order_relaxed);
 		}
 
+		/*!
+		 * \brief Check how many elements can be read from the buffer, can be called only from consumer side
+		 * \return Number of elements that can be read, counted from the same position as at() and operator[]
+		 */
+		index_t consumerReadAvailable(void) const {
+			index_t tmp_head = head.load(index_acquire_barrier);
+			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+
+			// same as consumerTail(), tail may be moved ahead of consumed elements by producerClear()
+			if(static_cast<index_t>(staged_tail - tmp_tail) <= capacity())
+				tmp_tail = staged_tail;
+
+			return tmp_head - tmp_tail;
+		}
+
 		/*!
 		 * \brief Check how many elements can be written into the buffer
-		 * \return Number of free slots that can be be written
+		 * \return Number of free slots that can be be written, elements inserted without publishing are counted as free
 		 */
 		index_t writeAvailable(void) const {
-			return buffer_size - (head.load(std::memory_order_relaxed) - tail.load(index_acquire_barrier));
+			return capacity() - (head.load(std::memory_order_relaxed) - tail.load(index_acquire_barrier));
+		}
+
+		/*!
+		 * \brief Check how many elements can be written into the buffer, can be called only from producer side
+		 * \return Number of free slots that can be be written, elements inserted without publishing are not counted as free
+		 */
+		index_t producerWriteAvailable(void) const {
+			return capacity() - (staged_head - tail.load(index_acquire_barrier));
 		}
 
 		/*!
 		 * \brief Inserts data into internal buffer, without blocking
-		 * \param data element to be inserted into internal buffer
+		 * \param data element to be copied into internal buffer
 		 * \return True if data was inserted
 		 */
-		bool insert(T data)
-		{
-			index_t tmp_head = head.load(std::memory_order_relaxed);
+		bool insert(const T& data) {
+			return emplace(data);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param data element to be moved into internal buffer, left untouched if there is no space
+		 * \return True if data was inserted
+		 */
+		bool insert(T&& data) {
+			return emplace(std::move(data));
+		}
 
-			if((tmp_head - tail.load(index_acquire_barrier)) == buffer_size)
+		/*!
+		 * \brief Constructs element in place inside internal buffer, without blocking
+		 * \param args Arguments forwarded to the constructor of T
+		 * \return True if element was constructed
+		 */
+		template<typename... Args>
+		bool emplace(Args&&... args)
+		{
+			if(!emplaceNoPublish(std::forward<Args>(args)...))
 				return false;
-			else
-			{
-				data_buff[tmp_head++ & buffer_mask] = data;
-				std::atomic_signal_fence(std::memory_order_release);
-				head.store(tmp_head, index_release_barrier);
-			}
+
+			publish();
 			return true;
 		}
 
 		/*!
-		 * \brief Inserts data into internal buffer, without blocking
-		 * \param[in] data Pointer to memory location where element, to be inserted into internal buffer, is located
+		 * \brief Inserts data into internal buffer without making it visible to consumer
+		 *
+		 * Element is published together with all previously staged ones by publish() or by any other
+		 * insertion function, so a burst of elements costs only one head update
+		 *
+		 * \param data element to be copied into internal buffer
 		 * \return True if data was inserted
 		 */
-		bool insert(const T* data)
+		bool insertNoPublish(const T& data) {
+			return emplaceNoPublish(data);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer without making it visible to consumer
+		 * \param data element to be moved into internal buffer, left untouched if there is no space
+		 * \return True if data was inserted
+		 */
+		bool insertNoPublish(T&& data) {
+			return emplaceNoPublish(std::move(data));
+		}
+
+		/*!
+		 * \brief Constructs element in place inside internal buffer without making it visible to consumer
+		 * \param args Arguments forwarded to the constructor of T
+		 * \return True if element was constructed
+		 */
+		template<typename... Args>
+		bool emplaceNoPublish(Args&&... args)
 		{
-			index_t tmp_head = head.load(std::memory_order_relaxed);
+			index_t tmp_head = staged_head;
 
-			if((tmp_head - tail.load(index_acquire_barrier)) == buffer_size)
+			if(producerAvailable(tmp_head, 1) == 0)
 				return false;
-			else
-			{
-				data_buff[tmp_head++ & buffer_mask] = *data;
-				std::atomic_signal_fence(std::memory_order_release);
-				head.store(tmp_head, index_release_barrier);
-			}
+
+			new(slot(tmp_head)) T(std::forward<Args>(args)...);
+			staged_head = tmp_head + 1;
 			return true;
 		}
 
+		/*!
+		 * \brief Make all staged elements visible to consumer
+		 */
+		void publish(void) {
+			std::atomic_signal_fence(std::memory_order_release);
+			head.store(staged_head, index_release_barrier);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param[in] data Pointer to memory location where element, to be inserted into internal buffer, is located
+		 * \return True if data was inserted
+		 */
+		bool insert(const T* data) {
+			return emplace(*data);
+		}
+
 		/*!
 		 * \brief Inserts data returned by callback function, into internal buffer, without blocking
 		 *
@@ -144,18 +378,31 @@ namespace jnk0le
 		 * \param get_data_callback Pointer to callback function that returns element to be inserted into buffer
 		 * \return True if data was inserted and callback called
 		 */
-		bool insertFromCallbackWhenAvailable(T (*get_data_callback)(void))
+		bool insertFromCallbackWhenAvailable(T (*get_data_callback)(void)) {
+			return insertFromCallbackWhenAvailable([get_data_callback]() { return get_data_callback(); });
+		}
+
+		/*!
+		 * \brief Inserts data returned by callable object, into internal buffer, without blocking
+		 *
+		 * Same as function pointer overload, but lambda expressions and functors can be inlined.
+		 *
+		 * \param get_data_callback Callable object that returns element to be inserted into buffer
+		 * \return True if data was inserted and callback called
+		 */
+		template<typename Callback, typename = decltype(std::declval<Callback&>()())>
+		bool insertFromCallbackWhenAvailable(Callback&& get_data_callback)
 		{
-			index_t tmp_head = head.load(std::memory_order_relaxed);
+			index_t tmp_head = staged_head;
 
-			if((tmp_head - tail.load(index_acquire_barrier)) == buffer_size)
+			if(producerAvailable(tmp_head, 1) == 0)
 				return false;
 			else
 			{
 				//execute callback only when there is space in buffer
-				data_buff[tmp_head++ & buffer_mask] = get_data_callback();
-				std::atomic_signal_fence(std::memory_order_release);
-				head.store(tmp_head, index_release_barrier);
+				new(slot(tmp_head++)) T(get_data_callback());
+				staged_head = tmp_head;
+				publish();
 			}
 			return true;
 		}
@@ -166,12 +413,12 @@ namespace jnk0le
 		 */
 		bool remove()
 		{
-			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+			index_t tmp_tail = consumerTail();
 
-			if(tmp_tail == head.load(std::memory_order_relaxed))
+			if(consumerAvailable(tmp_tail, 1) == 0)
 				return false;
 			else
-				tail.store(++tmp_tail, index_release_barrier); // release in case data was loaded/used before
+				consume(++tmp_tail);
 
 			return true;
 		}
@@ -182,17 +429,20 @@ namespace jnk0le
 		 * \return Number of removed elements
 		 */
 		size_t remove(size_t cnt) {
-			index_t tmp_tail = tail.load(std::memory_order_relaxed);
-			index_t avail = head.load(std::memory_order_relaxed) - tmp_tail;
+			index_t tmp_tail = consumerTail();
+			index_t avail = consumerAvailable(tmp_tail, cnt);
 
 			cnt = (cnt > avail) ? avail : cnt;
 
-			tail.store(tmp_tail + cnt, index_release_barrier);
+			consume(tmp_tail + cnt);
 			return cnt;
 		}
 
 		/*!
 		 * \brief Reads one element from internal buffer without blocking
+		 *
+		 * Element is move assigned into the destination and destroyed inside internal buffer when released
+		 *
 		 * \param[out] data Reference to memory location where removed element will be stored
 		 * \return True if data was fetched from the internal buffer
 		 */
@@ -206,15 +456,14 @@ namespace jnk0le
 		 * \return True if data was fetched from the internal buffer
 		 */
 		bool remove(T* data) {
-			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+			index_t tmp_tail = consumerTail();
 
-			if(tmp_tail == head.load(index_acquire_barrier))
+			if(consumerAvailable(tmp_tail, 1) == 0)
 				return false;
 			else
 			{
-				*data = data_buff[tmp_tail++ & buffer_mask];
-				std::atomic_signal_fence(std::memory_order_release);
-				tail.store(tmp_tail, index_release_barrier);
+				*data = std::move(*slot(tmp_tail++));
+				consume(tmp_tail);
 			}
 			return true;
 		}
@@ -227,12 +476,12 @@ namespace jnk0le
 		 * \return Pointer to first element, nullptr if buffer was empty
 		 */
 		T* peek() {
-			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+			index_t tmp_tail = consumerTail();
 
-			if(tmp_tail == head.load(index_acquire_barrier))
+			if(consumerAvailable(tmp_tail, 1) == 0)
 				return nullptr;
 			else
-				return &data_buff[tmp_tail & buffer_mask];
+				return slot(tmp_tail);
 		}
 
 		/*!
@@ -244,12 +493,12 @@ namespace jnk0le
 		 * \return Pointer to requested element, nullptr if index exceeds storage count
 		 */
 		T* at(size_t index) {
-			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+			index_t tmp_tail = consumerTail();
 
-			if((head.load(index_acquire_barrier) - tmp_tail) <= index)
+			if(consumerAvailable(tmp_tail, index + 1) <= index)
 				return nullptr;
 			else
-				return &data_buff[(tmp_tail + index) & buffer_mask];
+				return slot(tmp_tail + index);
 		}
 
 		/*!
@@ -257,14 +506,100 @@ namespace jnk0le
 		 *
 		 * Unchecked operation, assumes that software already knows if the element can be used, if
 		 * requested index is out of bounds then reference will point to somewhere inside the buffer
-		 * The isEmpty() and readAvailable() will place appropriate memory barriers if used as loop limiter
+		 * The consumerReadAvailable() will place appropriate memory barriers if used as loop limiter
 		 * It is safe to use and modify T contents only on consumer side
 		 *
 		 * \param index Item offset starting on the consumed side
 		 * \return Reference to requested element, undefined if index exceeds storage count
 		 */
 		T& operator[](size_t index) {
-			return data_buff[(tail.load(std::memory_order_relaxed) + index) & buffer_mask];
+			return *slot(consumerTail() + index);
+		}
+
+		/*!
+		 * \brief Acquire free slots for zero copy write
+		 *
+		 * Free region is returned as two contiguous blocks, the second one is non empty only if region wraps around
+		 * the end of internal buffer. Acquired slots can be written in place and published with writeCommit()
+		 * Slots are uninitialized storage, non trivial objects have to be constructed in them with placement new
+		 *
+		 * \param[out] spans Blocks of free slots, first block starts at current head
+		 * \param count Maximum number of slots to acquire
+		 * \return Total number of acquired slots
+		 */
+		size_t writeAcquire(span (&spans)[2], size_t count = (std::numeric_limits<size_t>::max)()) {
+			index_t tmp_head = staged_head;
+			index_t available = producerAvailable(tmp_head, count);
+
+			if(available < count) // do not acquire more than we can
+				count = available;
+
+			getSpans(spans, tmp_head, count);
+			return count;
+		}
+
+		/*!
+		 * \brief Publish elements written into slots obtained from writeAcquire()
+		 * \param count Number of elements to publish, must not exceed number of acquired slots
+		 */
+		void writeCommit(size_t count) {
+			staged_head += count;
+			publish();
+		}
+
+		/*!
+		 * \brief Acquire readable elements for zero copy read
+		 *
+		 * Readable region is returned as two contiguous blocks, the second one is non empty only if region wraps
+		 * around the end of internal buffer. It is safe to use and modify acquired elements only on consumer side,
+		 * until they are released (and later destroyed) with readRelease()
+		 *
+		 * \param[out] spans Blocks of readable elements, first block starts at current tail
+		 * \param count Maximum number of elements to acquire
+		 * \return Total number of acquired elements
+		 */
+		size_t readAcquire(span (&spans)[2], size_t count = (std::numeric_limits<size_t>::max)()) {
+			index_t tmp_tail = consumerTail();
+			index_t available = consumerAvailable(tmp_tail, count);
+
+			if(available < count) // do not acquire more than we can
+				count = available;
+
+			getSpans(spans, tmp_tail, count);
+			return count;
+		}
+
+		/*!
+		 * \brief Release elements obtained from readAcquire() back to producer
+		 * \param count Number of elements to release, must not exceed number of acquired elements
+		 */
+		void readRelease(size_t count) {
+			consume(consumerTail() + count);
+		}
+
+		/*!
+		 * \brief Set how often consumed elements are released back to producer
+		 *
+		 * Tail index is updated only after given number of elements were consumed since last release, or when
+		 * consumer observes that buffer was drained, so the tail cache line is pulled by producer less often.
+		 * Consumed elements are not available for writing, and are still counted by readAvailable(), until released.
+		 *
+		 * \param interval Number of elements, 1 (default) releases after every operation
+		 */
+		void setReleaseInterval(index_t interval) {
+			release_interval = interval;
+		}
+
+		/*!
+		 * \brief Release all consumed elements back to producer immediately
+		 */
+		void releaseTail(void) {
+			index_t tmp_staged = consumerTail();
+			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+
+			destroy(tmp_tail, static_cast<index_t>(tmp_staged - tmp_tail));
+			std::atomic_signal_fence(std::memory_order_release);
+			tail.store(tmp_staged, index_release_barrier); // release in case data was loaded/used before
 		}
 
 		/*!
@@ -292,7 +627,29 @@ namespace jnk0le
 		 * \param execute_data_callback Pointer to callback function executed after every loop iteration
 		 * \return Number of elements written into internal  buffer
 		 */
-		size_t writeBuff(const T* buff, size_t count, size_t count_to_callback, void (*execute_data_callback)(void));
+		size_t writeBuff(const T* buff, size_t count, size_t count_to_callback, void (*execute_data_callback)(void)) {
+			return writeBuff(buff, count, count_to_callback, [execute_data_callback]() {
+				if(execute_data_callback != nullptr)
+					execute_data_callback();
+			});
+		}
+
+		/*!
+		 * \brief Insert multiple elements into internal buffer without blocking
+		 *
+		 * Same as function pointer overload, but lambda expressions and functors can be inlined. Null pointer constants
+		 * (nullptr, NULL, 0) select the function pointer overload.
+		 *
+		 * \warning This function is not deterministic
+		 *
+		 * \param[in] buff Pointer to buffer with data to be inserted from
+		 * \param count Number of elements to write from the given buffer
+		 * \param count_to_callback Number of elements to write before calling a callback function in first loop
+		 * \param execute_data_callback Callable object executed after every loop iteration
+		 * \return Number of elements written into internal  buffer
+		 */
+		template<typename Callback, typename = decltype(std::declval<Callback&>()())>
+		size_t writeBuff(const T* buff, size_t count, size_t count_to_callback, Callback&& execute_data_callback);
 
 		/*!
 		 * \brief Load multiple elements from internal buffer without blocking
@@ -320,10 +677,173 @@ namespace jnk0le
 		 * \param execute_data_callback Pointer to callback function executed after every loop iteration
 		 * \return Number of elements that were read from internal buffer
 		 */
-		size_t readBuff(T* buff, size_t count, size_t count_to_callback, void (*execute_data_callback)(void));
+		size_t readBuff(T* buff, size_t count, size_t count_to_callback, void (*execute_data_callback)(void)) {
+			return readBuff(buff, count, count_to_callback, [execute_data_callback]() {
+				if(execute_data_callback != nullptr)
+					execute_data_callback();
+			});
+		}
+
+		/*!
+		 * \brief Load multiple elements from internal buffer without blocking
+		 *
+		 * Same as function pointer overload, but lambda expressions and functors can be inlined. Null pointer constants
+		 * (nullptr, NULL, 0) select the function pointer overload.
+		 *
+		 * \warning This function is not deterministic
+		 *
+		 * \param[out] buff Pointer to buffer where data will be loaded into
+		 * \param count Number of elements to load into the given buffer
+		 * \param count_to_callback Number of elements to load before calling a callback function in first iteration
+		 * \param execute_data_callback Callable object executed after every loop iteration
+		 * \return Number of elements that were read from internal buffer
+		 */
+		template<typename Callback, typename = decltype(std::declval<Callback&>()())>
+		size_t readBuff(T* buff, size_t count, size_t count_to_callback, Callback&& execute_data_callback);
 
 	private:
-		constexpr static index_t buffer_mask = buffer_size-1; //!< bitwise mask for a given buffer size
+		/*!
+		 * \brief Check on producer side how many elements can be written
+		 *
+		 * Opposite index is reloaded (with acquire barrier) only when cached copy indicates that there is less
+		 * than requested number of free slots, so the tail cache line is not pulled from consumer core on every write
+		 *
+		 * \param tmp_head Current value of head index
+		 * \param count Number of elements that are going to be written
+		 * \return Number of free slots, may be less than currently available if count is satisfied
+		 */
+		index_t producerAvailable(index_t tmp_head, size_t count) {
+			index_t avail = capacity() - (tmp_head - cached_tail);
+
+			if(avail >= count)
+				return avail;
+
+			cached_tail = tail.load(index_acquire_barrier);
+			return capacity() - (tmp_head - cached_tail);
+		}
+
+		/*!
+		 * \brief Check on consumer side how many elements can be read
+		 *
+		 * Opposite index is reloaded (with acquire barrier) only when cached copy indicates that there is less
+		 * than requested number of elements, so the head cache line is not pulled from producer core on every read
+		 *
+		 * \param tmp_tail Current value of tail index
+		 * \param count Number of elements that are going to be read
+		 * \return Number of elements that can be read, may be less than currently available if count is satisfied
+		 */
+		index_t consumerAvailable(index_t tmp_tail, size_t count) {
+			index_t avail = cached_head - tmp_tail;
+
+			// cached head may end up behind tail if buffer was cleared from producer side
+			if(avail >= count && avail <= capacity())
+				return avail;
+
+			cached_head = head.load(index_acquire_barrier);
+			return cached_head - tmp_tail;
+		}
+
+		/*!
+		 * \brief Get consumer side tail index
+		 * \return Index of the first element that was not consumed yet
+		 */
+		index_t consumerTail(void) {
+			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+
+			// tail may be moved ahead of consumed elements if buffer was cleared from producer side
+			if(static_cast<index_t>(staged_tail - tmp_tail) > capacity())
+				staged_tail = tmp_tail;
+
+			return staged_tail;
+		}
+
+		/*!
+		 * \brief Mark elements as consumed, releasing them to producer if release interval is reached
+		 * \param tmp_tail Index of the first element that was not consumed
+		 */
+		void consume(index_t tmp_tail) {
+			staged_tail = tmp_tail;
+
+			if(static_cast<index_t>(tmp_tail - tail.load(std::memory_order_relaxed)) >= release_interval
+					|| tmp_tail == cached_head) // drained
+				releaseTail();
+		}
+
+		/*!
+		 * \brief Split region of internal buffer into contiguous blocks
+		 * \param[out] spans Blocks covering the region, second one is empty if region doesn't wrap around
+		 * \param index Index of first element of the region
+		 * \param count Number of elements in the region
+		 */
+		void getSpans(span (&spans)[2], index_t index, size_t count) {
+			size_t offset = index & buffer_mask;
+			size_t first = capacity() - offset;
+
+			if(first > count)
+				first = count;
+
+			spans[0].data = slot(offset);
+			spans[0].size = first;
+			spans[1].data = slot(0);
+			spans[1].size = count - first;
+		}
+
+		/*!
+		 * \brief Destroy elements inside internal buffer, optimized out for trivially destructible types
+		 * \param index Index of first element to destroy
+		 * \param count Number of elements to destroy
+		 */
+		void destroy(index_t index, size_t count) {
+			for(size_t i = 0; i < count; i++)
+				slot(index++)->~T();
+		}
+
+		/*!
+		 * \brief Copy elements into internal buffer, in at most two contiguous blocks
+		 * \param index Index of first slot to write into
+		 * \param[in] buff Pointer to buffer with data to be copied from
+		 * \param count Number of elements to copy
+		 */
+		void copyIn(index_t index, const T* buff, size_t count) {
+			copyIn(index, buff, count, std::is_trivially_copyable<T>());
+		}
+
+		void copyIn(index_t index, const T* buff, size_t count, std::true_type) {
+			span spans[2];
+			getSpans(spans, index, count);
+
+			memcpy(spans[0].data, buff, spans[0].size * sizeof(T));
+			memcpy(spans[1].data, buff + spans[0].size, spans[1].size * sizeof(T));
+		}
+
+		void copyIn(index_t index, const T* buff, size_t count, std::false_type) {
+			for(size_t i = 0; i < count; i++)
+				new(slot(index++)) T(buff[i]);
+		}
+
+		/*!
+		 * \brief Move elements out of internal buffer, in at most two contiguous blocks, destroyed when released
+		 * \param[out] buff Pointer to buffer where data will be copied into
+		 * \param index Index of first slot to read from
+		 * \param count Number of elements to copy
+		 */
+		void copyOut(T* buff, index_t index, size_t count) {
+			copyOut(buff, index, count, std::is_trivially_copyable<T>());
+		}
+
+		void copyOut(T* buff, index_t index, size_t count, std::true_type) {
+			span spans[2];
+			getSpans(spans, index, count);
+
+			memcpy(buff, spans[0].data, spans[0].size * sizeof(T));
+			memcpy(buff + spans[0].size, spans[1].data, spans[1].size * sizeof(T));
+		}
+
+		void copyOut(T* buff, index_t index, size_t count, std::false_type) {
+			for(size_t i = 0; i < count; i++)
+				buff[i] = std::move(*slot(index++));
+		}
+
 		constexpr static std::memory_order index_acquire_barrier = fake_tso ?
 				  std::memory_order_relaxed
 				: std::memory_order_acquire; // do not load from, or store to buffer before confirmed by the opposite side
@@ -331,55 +851,52 @@ namespace jnk0le
 				  std::memory_order_relaxed
 				: std::memory_order_release; // do not update own side before all operations on data_buff committed
 
-		alignas(cacheline_size) std::atomic<index_t> head; //!< head index
-		alignas(cacheline_size) std::atomic<index_t> tail; //!< tail index
-
-		// put buffer after variables so everything can be reached with short offsets
-		alignas(cacheline_size) T data_buff[buffer_size]; //!< actual buffer
+		using storage::head;
+		using storage::cached_tail;
+		using storage::staged_head;
+		using storage::tail;
+		using storage::cached_head;
+		using storage::staged_tail;
+		using storage::release_interval;
+		using storage::buffer_mask;
+		using storage::slot;
 
 		// let's assert that no UB will be compiled in
-		static_assert((buffer_size != 0), "buffer cannot be of zero size");
-		static_assert((buffer_size & buffer_mask) == 0, "buffer size is not a power of 2");
 		static_assert(sizeof(index_t) <= sizeof(size_t),
 			"indexing type size is larger than size_t, operation is not lock free and doesn't make sense");
 
 		static_assert(std::numeric_limits<index_t>::is_integer, "indexing type is not integral type");
 		static_assert(!(std::numeric_limits<index_t>::is_signed), "indexing type must not be signed");
-		static_assert(buffer_mask <= ((std::numeric_limits<index_t>::max)() >> 1),
-			"buffer size is too large for a given indexing type (maximum size for n-bit type is 2^(n-1))");
-
-		static_assert(std::is_trivial<T>::value, "non trivial objects will currently break");
 	};
 
 	template<typename T, size_t buffer_size, bool fake_tso, size_t cacheline_size, typename index_t>
 	size_t Ringbuffer<T, buffer_size, fake_tso, cacheline_size, index_t>::writeBuff(const T* buff, size_t count)
 	{
 		index_t available = 0;
-		index_t tmp_head = head.load(std::memory_order_relaxed);
+		index_t tmp_head = staged_head;
 		size_t to_write = count;
 
-		available = buffer_size - (tmp_head - tail.load(index_acquire_barrier));
+		available = producerAvailable(tmp_head, count);
 
 		if(available < count) // do not write more than we can
 			to_write = available;
 
-		// maybe divide it into 2 separate writes
-		for(size_t i = 0; i < to_write; i++)
-			data_buff[tmp_head++ & buffer_mask] = buff[i];
+		copyIn(tmp_head, buff, to_write);
+		staged_head = tmp_head + to_write;
 
-		std::atomic_signal_fence(std::memory_order_release);
-		head.store(tmp_head, index_release_barrier);
+		publish();
 
 		return to_write;
 	}
 
 	template<typename T, size_t buffer_size, bool fake_tso, size_t cacheline_size, typename index_t>
+	template<typename Callback, typename>
 	size_t Ringbuffer<T, buffer_size, fake_tso, cacheline_size, index_t>::writeBuff(const T* buff, size_t count,
-			size_t count_to_callback, void(*execute_data_callback)())
+			size_t count_to_callback, Callback&& execute_data_callback)
 	{
 		size_t written = 0;
 		index_t available = 0;
-		index_t tmp_head = head.load(std::memory_order_relaxed);
+		index_t tmp_head = staged_head;
 		size_t to_write = count;
 
 		if(count_to_callback != 0 && count_to_callback < count)
@@ -387,7 +904,7 @@ namespace jnk0le
 
 		while(written < count)
 		{
-			available = buffer_size - (tmp_head - tail.load(index_acquire_barrier));
+			available = producerAvailable(tmp_head, to_write);
 
 			if(available == 0) // less than ??
 				break;
@@ -395,14 +912,14 @@ namespace jnk0le
 			if(to_write > available) // do not write more than we can
 				to_write = available;
 
-			while(to_write--)
-				data_buff[tmp_head++ & buffer_mask] = buff[written++];
+			copyIn(tmp_head, &buff[written], to_write);
+			tmp_head += to_write;
+			written += to_write;
 
-			std::atomic_signal_fence(std::memory_order_release);
-			head.store(tmp_head, index_release_barrier);
+			staged_head = tmp_head;
+			publish();
 
-			if(execute_data_callback != nullptr)
-				execute_data_callback();
+			execute_data_callback();
 
 			to_write = count - written;
 		}
@@ -414,31 +931,28 @@ namespace jnk0le
 	size_t Ringbuffer<T, buffer_size, fake_tso, cacheline_size, index_t>::readBuff(T* buff, size_t count)
 	{
 		index_t available = 0;
-		index_t tmp_tail = tail.load(std::memory_order_relaxed);
+		index_t tmp_tail = consumerTail();
 		size_t to_read = count;
 
-		available = head.load(index_acquire_barrier) - tmp_tail;
+		available = consumerAvailable(tmp_tail, count);
 
 		if(available < count) // do not read more than we can
 			to_read = available;
 
-		// maybe divide it into 2 separate reads
-		for(size_t i = 0; i < to_read; i++)
-			buff[i] = data_buff[tmp_tail++ & buffer_mask];
-
-		std::atomic_signal_fence(std::memory_order_release);
-		tail.store(tmp_tail, index_release_barrier);
+		copyOut(buff, tmp_tail, to_read);
+		consume(tmp_tail + to_read);
 
 		return to_read;
 	}
 
 	template<typename T, size_t buffer_size, bool fake_tso, size_t cacheline_size, typename index_t>
+	template<typename Callback, typename>
 	size_t Ringbuffer<T, buffer_size, fake_tso, cacheline_size, index_t>::readBuff(T* buff, size_t count,
-			size_t count_to_callback, void(*execute_data_callback)())
+			size_t count_to_callback, Callback&& execute_data_callback)
 	{
 		size_t read = 0;
 		index_t available = 0;
-		index_t tmp_tail = tail.load(std::memory_order_relaxed);
+		index_t tmp_tail = consumerTail();
 		size_t to_read = count;
 
 		if(count_to_callback != 0 && count_to_callback < count)
@@ -446,7 +960,7 @@ namespace jnk0le
 
 		while(read < count)
 		{
-			available = head.load(index_acquire_barrier) - tmp_tail;
+			available = consumerAvailable(tmp_tail, to_read);
 
 			if(available == 0) // less than ??
 				break;
@@ -454,14 +968,13 @@ namespace jnk0le
 			if(to_read > available) // do not write more than we can
 				to_read = available;
 
-			while(to_read--)
-				buff[read++] = data_buff[tmp_tail++ & buffer_mask];
+			copyOut(&buff[read], tmp_tail, to_read);
+			tmp_tail += to_read;
+			read += to_read;
 
-			std::atomic_signal_fence(std::memory_order_release);
-			tail.store(tmp_tail, index_release_barrier);
+			consume(tmp_tail);
 
-			if(execute_data_callback != nullptr)
-				execute_data_callback();
+			execute_data_callback();
 
 			to_read = count - read;
 		}
@@ -469,6 +982,17 @@ namespace jnk0le
 		return read;
 	}
 
+	/*!
+	 * \brief Ringbuffer with capacity and storage given at construction time
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	using ExternalRingbuffer = Ringbuffer<T, 0, fake_tso, cacheline_size, index_t>;
+
 } // namespace
 
 #endif //RINGBUFFER_HPP
@@ -0,0 +1,271 @@
+/*!
+ * \file ringbuffer_coro.hpp
+ * \brief C++20 coroutine awaitables for Ringbuffer
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_CORO_HPP
+#define RINGBUFFER_CORO_HPP
+
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <coroutine>
+#include <utility>
+
+#include "ringbuffer_notify.hpp"
+
+namespace jnk0le
+{
+	namespace detail
+	{
+		/*!
+		 * \brief Slot for single suspended coroutine, resumed by the first notification that satisfies its condition
+		 *
+		 * Waiter checks the condition, publishes its handle and then checks if any notification arrived since the
+		 * condition was checked. Notifier counts the notification after making the condition true and then checks
+		 * the handle. Both sides use full fence in between, so at least one of them observes the other.
+		 *
+		 * Condition is evaluated only by whoever holds the handle, waiter before publishing it and notifier after
+		 * taking it out of the slot, so state owned by suspended side is never accessed concurrently. If condition is
+		 * not satisfied yet (e.g. consumed elements were not released), notifier puts the handle back.
+		 */
+		class CoroutineNotifier
+		{
+		public:
+			CoroutineNotifier()
+				: waiter(nullptr), events(0), ready_callback(nullptr), ready_context(nullptr),
+				  executor(nullptr), executor_context(nullptr) {}
+
+			/*!
+			 * \brief Set function used to resume suspended coroutine
+			 * \param resume_callback Function scheduling the coroutine, nullptr to resume it in place
+			 * \param context Pointer passed to the callback
+			 */
+			void setExecutor(void (*resume_callback)(std::coroutine_handle<> handle, void* context), void* context) {
+				executor = resume_callback;
+				executor_context = context;
+			}
+
+			/*!
+			 * \brief Suspend coroutine until condition is satisfied
+			 * \param handle Coroutine to be suspended
+			 * \param ready Condition to wait for, evaluated also by the notifier
+			 * \param context Pointer passed to the condition, must stay valid while coroutine is suspended
+			 * \return False if condition was satisfied and coroutine should not be suspended
+			 */
+			bool suspend(std::coroutine_handle<> handle, bool (*ready)(void* context), void* context)
+			{
+				ready_callback = ready;
+				ready_context = context;
+
+				for(;;)
+				{
+					uint32_t seen = events.load(std::memory_order_acquire);
+
+					if(ready(context))
+						return false;
+
+					waiter.store(handle.address(), std::memory_order_release);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+
+					if(events.load(std::memory_order_relaxed) == seen)
+						return true;
+
+					// if notifier took the handle in the meantime, it is responsible for the coroutine
+					if(waiter.exchange(nullptr, std::memory_order_acquire) == nullptr)
+						return true;
+				}
+			}
+
+			/*!
+			 * \brief Resume suspended coroutine, after condition may have been made true
+			 */
+			void notify(void)
+			{
+				// single notifier, so no need for read-modify-write
+				events.store(events.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if(waiter.load(std::memory_order_relaxed) == nullptr)
+					return;
+
+				void* address = waiter.exchange(nullptr, std::memory_order_acquire);
+
+				if(address == nullptr)
+					return;
+
+				if(!ready_callback(ready_context))
+				{
+					// only this side can satisfy the condition later, and it will notify again
+					waiter.store(address, std::memory_order_release);
+					return;
+				}
+
+				std::coroutine_handle<> handle = std::coroutine_handle<>::from_address(address);
+
+				if(executor != nullptr)
+					executor(handle, executor_context);
+				else
+					handle.resume();
+			}
+
+		private:
+			std::atomic<void*> waiter; //!< address of suspended coroutine, nullptr if none
+			std::atomic<uint32_t> events; //!< number of notifications
+			bool (*ready_callback)(void* context); //!< condition of suspended coroutine
+			void* ready_context; //!< context passed to condition
+			void (*executor)(std::coroutine_handle<> handle, void* context); //!< resume hook, nullptr for in place resume
+			void* executor_context; //!< context passed to resume hook
+		};
+	} // namespace detail
+
+	/*!
+	 * \brief SPSC ringbuffer with awaitable push and pop
+	 *
+	 * Coroutine awaiting pop() is suspended while buffer is empty and resumed from the producer operation that
+	 * makes data available, and vice versa for push(). Resumption happens in place, in the thread of the opposite
+	 * side, unless executor hook is set. At most one coroutine can await on each side at a time.
+	 *
+	 * \code
+	 * jnk0le::AwaitableRingbuffer<message, 256> rb;
+	 *
+	 * task consumer() {
+	 *     for(;;)
+	 *         handle(co_await rb.pop());
+	 * }
+	 * \endcode
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	class AwaitableRingbuffer
+		: public detail::NotifyingRingbuffer<T, buffer_size, fake_tso, cacheline_size, index_t, detail::CoroutineNotifier>
+	{
+		typedef detail::NotifyingRingbuffer<T, buffer_size, fake_tso, cacheline_size, index_t, detail::CoroutineNotifier> notifying;
+
+	public:
+		using typename notifying::span;
+
+		/*!
+		 * \brief Awaitable returned from pop(), resumes with element removed from buffer
+		 */
+		class PopAwaitable
+		{
+		public:
+			explicit PopAwaitable(AwaitableRingbuffer& ringbuffer) : rb(ringbuffer) {}
+
+			bool await_ready(void) {
+				return rb.peek() != nullptr;
+			}
+
+			bool await_suspend(std::coroutine_handle<> handle) {
+				rb.releaseTail(); // producer may wait for elements consumed with release interval
+				return rb.data_notifier.suspend(handle, ready, this);
+			}
+
+			T await_resume(void) {
+				T data(std::move(*rb.peek()));
+				rb.remove();
+				return data;
+			}
+
+		private:
+			static bool ready(void* self) {
+				return static_cast<PopAwaitable*>(self)->rb.peek() != nullptr;
+			}
+
+			AwaitableRingbuffer& rb; //!< awaited buffer
+		};
+
+		/*!
+		 * \brief Awaitable returned from push(), resumes after element was inserted into buffer
+		 */
+		class PushAwaitable
+		{
+		public:
+			PushAwaitable(AwaitableRingbuffer& ringbuffer, T&& element)
+				: rb(ringbuffer), data(std::move(element)), inserted(false) {}
+
+			bool await_ready(void) {
+				inserted = rb.insert(std::move(data));
+				return inserted;
+			}
+
+			bool await_suspend(std::coroutine_handle<> handle) {
+				rb.publish(); // consumer may wait for elements inserted without publishing
+				return rb.space_notifier.suspend(handle, ready, this);
+			}
+
+			void await_resume(void) {
+				if(!inserted) // space was made available for single producer, so it can't fail
+					inserted = rb.insert(std::move(data));
+			}
+
+		private:
+			static bool ready(void* self) {
+				span spans[2];
+				return static_cast<PushAwaitable*>(self)->rb.writeAcquire(spans, 1) != 0;
+			}
+
+			AwaitableRingbuffer& rb; //!< awaited buffer
+			T data; //!< element to be inserted, moved out when inserted
+			bool inserted; //!< element was already inserted
+		};
+
+		/*!
+		 * \brief Remove element from buffer, suspending awaiting coroutine while buffer is empty
+		 * \return Awaitable resuming with removed element
+		 */
+		PopAwaitable pop(void) {
+			return PopAwaitable(*this);
+		}
+
+		/*!
+		 * \brief Insert element into buffer, suspending awaiting coroutine while buffer is full
+		 * \param data Element to be moved into internal buffer
+		 * \return Awaitable resuming after element was inserted
+		 */
+		PushAwaitable push(T data) {
+			return PushAwaitable(*this, std::move(data));
+		}
+
+		/*!
+		 * \brief Set function used to resume coroutine waiting on consumer side
+		 * \param resume_callback Function scheduling the coroutine (e.g. posting it to executor queue), nullptr to
+		 * resume it in place from the producer
+		 * \param context Pointer passed to the callback
+		 */
+		void setConsumerExecutor(void (*resume_callback)(std::coroutine_handle<> handle, void* context), void* context = nullptr) {
+			data_notifier.setExecutor(resume_callback, context);
+		}
+
+		/*!
+		 * \brief Set function used to resume coroutine waiting on producer side
+		 * \param resume_callback Function scheduling the coroutine (e.g. posting it to executor queue), nullptr to
+		 * resume it in place from the consumer
+		 * \param context Pointer passed to the callback
+		 */
+		void setProducerExecutor(void (*resume_callback)(std::coroutine_handle<> handle, void* context), void* context = nullptr) {
+			space_notifier.setExecutor(resume_callback, context);
+		}
+
+	private:
+		using notifying::data_notifier;
+		using notifying::space_notifier;
+	};
+
+} // namespace
+
+#endif // __has_include(<coroutine>)
+#endif // __cpp_impl_coroutine
+
+#endif //RINGBUFFER_CORO_HPP
@@ -0,0 +1,184 @@
+/*!
+ * \file ringbuffer_iovec.hpp
+ * \brief Export of Ringbuffer readable and writable regions as iovec, for readv()/writev() family and batch
+ * socket receive
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_IOVEC_HPP
+#define RINGBUFFER_IOVEC_HPP
+
+#include <stddef.h>
+#include <limits>
+#include <type_traits>
+#include <sys/uio.h>
+#if defined(__linux__)
+#include <sys/socket.h>
+#endif
+
+#include "ringbuffer.hpp"
+
+namespace jnk0le
+{
+	namespace detail
+	{
+		/*!
+		 * \brief Convert spans of elements into iovec
+		 * \param[in] spans Blocks of elements
+		 * \param[out] iov Blocks of bytes, second one is empty if region doesn't wrap
+		 */
+		template<typename Span>
+		void spansToIovec(const Span (&spans)[2], struct iovec (&iov)[2])
+		{
+			typedef typename std::remove_reference<decltype(*spans[0].data)>::type element_t;
+
+			static_assert(std::is_trivially_copyable<element_t>::value,
+				"elements are read or written as plain memory by the kernel");
+
+			for(int i = 0; i < 2; i++)
+			{
+				iov[i].iov_base = spans[i].data;
+				iov[i].iov_len = spans[i].size * sizeof(element_t);
+			}
+		}
+	} // namespace detail
+
+	/*!
+	 * \brief Describe elements that can be read as iovec, from consumer side
+	 *
+	 * Data can be passed directly to writev(), sendmsg() etc. Elements have to be released afterwards
+	 * with readRelease(), only up to number of whole elements that were actually transferred.
+	 *
+	 * \code
+	 * struct iovec iov[2];
+	 * if(jnk0le::readAcquireIovec(rb, iov) != 0)
+	 * {
+	 *     ssize_t sent = writev(sock, iov, 2);
+	 *     if(sent > 0)
+	 *         rb.readRelease(sent / sizeof(T));
+	 * }
+	 * \endcode
+	 *
+	 * \param rb Ringbuffer (or wrapper) providing readAcquire() with two spans
+	 * \param[out] iov Readable blocks, second one is non empty only if region wraps around the end of the buffer
+	 * \param count Maximum number of elements to acquire
+	 * \return Total number of acquired elements
+	 */
+	template<typename Buffer>
+	size_t readAcquireIovec(Buffer& rb, struct iovec (&iov)[2], size_t count = (std::numeric_limits<size_t>::max)())
+	{
+		typename Buffer::span spans[2];
+		size_t acquired = rb.readAcquire(spans, count);
+
+		detail::spansToIovec(spans, iov);
+		return acquired;
+	}
+
+	/*!
+	 * \brief Describe free slots that can be written as iovec, from producer side
+	 *
+	 * Slots can be filled directly by readv(), recvmsg() etc. Data has to be published afterwards with
+	 * writeCommit(), only up to number of whole elements that were actually received.
+	 *
+	 * \code
+	 * struct iovec iov[2];
+	 * if(jnk0le::writeAcquireIovec(rb, iov) != 0)
+	 * {
+	 *     ssize_t received = readv(sock, iov, 2);
+	 *     if(received > 0)
+	 *         rb.writeCommit(received / sizeof(T));
+	 * }
+	 * \endcode
+	 *
+	 * \param rb Ringbuffer (or wrapper) providing writeAcquire() with two spans
+	 * \param[out] iov Writable blocks, second one is non empty only if region wraps around the end of the buffer
+	 * \param count Maximum number of slots to acquire
+	 * \return Total number of acquired slots
+	 */
+	template<typename Buffer>
+	size_t writeAcquireIovec(Buffer& rb, struct iovec (&iov)[2], size_t count = (std::numeric_limits<size_t>::max)())
+	{
+		typename Buffer::span spans[2];
+		size_t acquired = rb.writeAcquire(spans, count);
+
+		detail::spansToIovec(spans, iov);
+		return acquired;
+	}
+
+#if defined(__linux__)
+	/*!
+	 * \brief Receive batch of datagrams with single recvmmsg() call, directly into free slots of the buffer
+	 *
+	 * Every datagram is received into its own slot and exactly the number of received datagrams is committed.
+	 * Slot layout is described by the caller, e.g. for packet slot with length field:
+	 *
+	 * \code
+	 * struct packet { uint16_t len; uint8_t data[2046]; };
+	 * jnk0le::Ringbuffer<packet, 4096> rb;
+	 *
+	 * int received = jnk0le::recvmmsgToBuffer(rb, sock,
+	 *     [](packet& p) { return iovec{p.data, sizeof(p.data)}; },
+	 *     [](packet& p, const mmsghdr& msg) { p.len = msg.msg_len; },
+	 *     MSG_DONTWAIT);
+	 * \endcode
+	 *
+	 * \tparam max_batch Maximum number of datagrams received at once
+	 * \param rb Ringbuffer (or wrapper) providing writeAcquire() with two spans and writeCommit()
+	 * \param sockfd Socket to receive from
+	 * \param payload Callable returning iovec with receive area of given slot, as iovec(T& slot)
+	 * \param complete Callable storing received length (or flags) into slot, as void(T& slot, const mmsghdr& msg)
+	 * \param flags Flags passed to recvmmsg()
+	 * \return Number of received datagrams, 0 if buffer is full, -1 on error (errno is set by recvmmsg())
+	 */
+	template<size_t max_batch = 32, typename Buffer, typename Payload, typename Complete>
+	int recvmmsgToBuffer(Buffer& rb, int sockfd, Payload&& payload, Complete&& complete, int flags = 0)
+	{
+		typename Buffer::span spans[2];
+		struct iovec iov[max_batch];
+		struct mmsghdr msgs[max_batch];
+
+		typedef typename std::remove_reference<decltype(*spans[0].data)>::type element_t;
+
+		static_assert(std::is_trivially_copyable<element_t>::value, "slots are written as plain memory by the kernel");
+		static_assert(max_batch != 0, "batch must contain at least one datagram");
+
+		size_t acquired = rb.writeAcquire(spans, max_batch);
+
+		if(acquired == 0)
+			return 0;
+
+		for(size_t i = 0; i < acquired; i++)
+		{
+			element_t& slot = (i < spans[0].size) ? spans[0].data[i] : spans[1].data[i - spans[0].size];
+
+			iov[i] = payload(slot);
+			msgs[i].msg_hdr.msg_name = nullptr;
+			msgs[i].msg_hdr.msg_namelen = 0;
+			msgs[i].msg_hdr.msg_iov = &iov[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+			msgs[i].msg_hdr.msg_control = nullptr;
+			msgs[i].msg_hdr.msg_controllen = 0;
+			msgs[i].msg_hdr.msg_flags = 0;
+			msgs[i].msg_len = 0;
+		}
+
+		int received = recvmmsg(sockfd, msgs, static_cast<unsigned int>(acquired), flags, nullptr);
+
+		if(received <= 0)
+			return received;
+
+		for(int i = 0; i < received; i++)
+		{
+			size_t idx = static_cast<size_t>(i);
+			complete((idx < spans[0].size) ? spans[0].data[idx] : spans[1].data[idx - spans[0].size], msgs[i]);
+		}
+
+		rb.writeCommit(static_cast<size_t>(received));
+		return received;
+	}
+#endif
+
+} // namespace
+
+#endif //RINGBUFFER_IOVEC_HPP
@@ -0,0 +1,705 @@
+/*!
+ * \file ringbuffer_journal.hpp
+ * \brief Crash consistent, memory mapped file backed record ring buffer
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_JOURNAL_HPP
+#define RINGBUFFER_JOURNAL_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <atomic>
+#include <new>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(__SSE4_2__) && defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+#include "ringbuffer_record.hpp"
+
+namespace jnk0le
+{
+	namespace detail
+	{
+#if !(defined(__SSE4_2__) && defined(__x86_64__)) && !defined(__ARM_FEATURE_CRC32)
+		/*!
+		 * \brief Byte at a time lookup table for CRC-32C, generated on first use
+		 */
+		struct Crc32cTable
+		{
+			Crc32cTable()
+			{
+				for(uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t crc = i;
+
+					for(int bit = 0; bit < 8; bit++)
+						crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+
+					entries[i] = crc;
+				}
+			}
+
+			uint32_t entries[256];
+		};
+#endif
+
+		/*!
+		 * \brief Calculate CRC-32C (Castagnoli), can be chained over multiple blocks
+		 *
+		 * Uses crc32 instructions if available (SSE 4.2 on x86-64, CRC extension on ARM), 1KiB table otherwise.
+		 *
+		 * \param crc Result of previous block, 0 for the first one
+		 * \param[in] data Block of bytes
+		 * \param length Number of bytes in block
+		 * \return Checksum
+		 */
+		inline uint32_t crc32c(uint32_t crc, const void* data, size_t length)
+		{
+			const uint8_t* bytes = static_cast<const uint8_t*>(data);
+			crc = ~crc;
+
+#if defined(__SSE4_2__) && defined(__x86_64__)
+			for(; length >= 8; length -= 8, bytes += 8)
+			{
+				uint64_t word;
+				memcpy(&word, bytes, 8);
+				crc = static_cast<uint32_t>(_mm_crc32_u64(crc, word));
+			}
+
+			for(; length != 0; length--)
+				crc = _mm_crc32_u8(crc, *bytes++);
+#elif defined(__ARM_FEATURE_CRC32)
+			for(; length >= 8; length -= 8, bytes += 8)
+			{
+				uint64_t word;
+				memcpy(&word, bytes, 8);
+				crc = __crc32cd(crc, word);
+			}
+
+			for(; length != 0; length--)
+				crc = __crc32cb(crc, *bytes++);
+#else
+			static const Crc32cTable table;
+
+			for(; length != 0; length--)
+				crc = (crc >> 8) ^ table.entries[(crc ^ *bytes++) & 0xff];
+#endif
+
+			return ~crc;
+		}
+	} // namespace detail
+
+	/*!
+	 * \brief SPSC record ringbuffer placed in memory mapped file, recovered after process restart or system crash
+	 *
+	 * Indexes and records live in the file, so unconsumed records survive the restart without separate write
+	 * ahead log. Every record is stored as 8 byte header (length and CRC-32C) followed by payload, and is
+	 * contiguous in memory like in RecordRingbuffer. Checksum covers also absolute position and open epoch,
+	 * so stale records left from previous laps or previous runs are never recovered.
+	 *
+	 * Records up to durable head were synced with msync() by flush() and are trusted. On open, records past
+	 * durable head are validated and the head is extended up to the first torn or stale one.
+	 * Consumed records are released with tail index, producer doesn't overwrite them until the tail was synced
+	 * too, so records are delivered at least once (records consumed after last sync are delivered again).
+	 *
+	 * With flush_none policy data is persisted only by kernel writeback (or explicit flush()), which survives
+	 * process crash but not system crash.
+	 *
+	 * \code
+	 * jnk0le::JournalRingbuffer<1 << 20> journal;
+	 * if(!journal.open("/var/lib/app/events.journal"))
+	 *     return;
+	 * journal.setFlushPolicy(journal.flush_batched, 64 * 1024);
+	 *
+	 * journal.write(&event, sizeof(event)); // producer
+	 *
+	 * jnk0le::JournalRingbuffer<1 << 20>::record rec; // consumer
+	 * while(journal.readAcquire(rec))
+	 * {
+	 *     apply(rec.data, rec.size);
+	 *     journal.readRelease();
+	 * }
+	 * \endcode
+	 *
+	 * \tparam buffer_size Size of the record area in bytes. Must be a power of 2, at least 16.
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes
+	 */
+	template<size_t buffer_size = 65536, size_t cacheline_size = 0>
+	class JournalRingbuffer
+	{
+	public:
+		constexpr static uint32_t layout_magic = 0x4a52424a; //!< "JRBJ", marks initialized file
+		constexpr static uint32_t layout_version = 1; //!< incremented on incompatible change of file layout
+
+		/*!
+		 * \brief When records are synced to the file
+		 */
+		enum flush_policy {
+			flush_none, //!< only explicit flush(), records survive process crash
+			flush_batched, //!< after given number of bytes was committed since last flush
+			flush_every_commit //!< before writeCommit() returns
+		};
+
+		/*!
+		 * \brief Record acquired on consumer side
+		 */
+		struct record {
+			void* data; //!< pointer to payload, aligned to 8 bytes
+			size_t size; //!< payload size in bytes
+		};
+
+		/*!
+		 * \brief Description of the file, placed at the beginning of the mapping, in its own page
+		 */
+		struct header_t {
+			std::atomic<uint32_t> magic; //!< layout_magic, stored last when file is created
+			uint32_t version; //!< layout_version of the creator
+			uint64_t capacity; //!< size of the record area in bytes
+			uint32_t cacheline; //!< cacheline_size template parameter
+			uint32_t epoch; //!< incremented on every open, covered by record checksum
+			std::atomic<uint64_t> durable_head; //!< records before this index are synced to the file
+			alignas(cacheline_size) std::atomic<uint64_t> head; //!< published records, in 8 byte units
+			alignas(cacheline_size) std::atomic<uint64_t> tail; //!< released records, in 8 byte units
+		};
+
+		JournalRingbuffer()
+			: header(nullptr), data_buff(nullptr), file_fd(-1), header_epoch(0), policy(flush_none), flush_interval(0),
+			  staged_head(0), durable_head(0), durable_tail(0), reserved(nullptr),
+			  staged_tail(0), cached_head(0), acquired_units(0), units(*this) {}
+		~JournalRingbuffer() { close(); }
+
+		JournalRingbuffer(const JournalRingbuffer&) = delete;
+		JournalRingbuffer& operator=(const JournalRingbuffer&) = delete;
+
+		/*!
+		 * \brief Open or create journal file and recover records written before restart, previous file is closed
+		 * \param path Path to the file
+		 * \param mode Permissions of the created file
+		 * \return True if file was created or its layout matches this instantiation and recovery succeeded
+		 */
+		bool open(const char* path, mode_t mode = 0600)
+		{
+			close();
+
+			int fd = ::open(path, O_RDWR | O_CREAT | O_CLOEXEC, mode);
+			struct stat st;
+
+			if(fd < 0)
+				return false;
+
+			if(fstat(fd, &st) != 0 || (st.st_size != 0 && static_cast<size_t>(st.st_size) != mapping_size)
+				|| (st.st_size == 0 && ftruncate(fd, mapping_size) != 0))
+			{
+				::close(fd);
+				return false;
+			}
+
+			void* mem = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+			if(mem == MAP_FAILED)
+			{
+				::close(fd);
+				return false;
+			}
+
+			file_fd = fd;
+			header = static_cast<header_t*>(mem);
+			data_buff = reinterpret_cast<uint64_t*>(static_cast<uint8_t*>(mem) + data_offset);
+
+			bool opened = (st.st_size == 0 || isBlank()) ? initialize() : recover();
+
+			if(!opened)
+				unmap(); // don't touch file that wasn't recovered
+
+			return opened;
+		}
+
+		/*!
+		 * \brief Flush and unmap the file
+		 */
+		void close(void)
+		{
+			if(header != nullptr)
+				flush();
+
+			unmap();
+		}
+
+		/*!
+		 * \brief Check if journal file is open
+		 * \return True if file is open
+		 */
+		bool isOpen(void) const {
+			return header != nullptr;
+		}
+
+		/*!
+		 * \brief Set when committed records are synced to the file, from producer side
+		 * \param new_policy Policy
+		 * \param interval Number of committed bytes triggering flush with flush_batched policy
+		 */
+		void setFlushPolicy(flush_policy new_policy, size_t interval = 0) {
+			policy = new_policy;
+			flush_interval = interval;
+		}
+
+		/*!
+		 * \brief Get maximum payload size of a single record
+		 * \return Size in bytes
+		 */
+		constexpr static size_t maxRecordSize(void) {
+			return buffer_size - sizeof(uint64_t);
+		}
+
+		/*!
+		 * \brief Check if buffer is empty
+		 * \return True if buffer is empty
+		 */
+		bool isEmpty(void) const {
+			return header->head.load(std::memory_order_acquire) == header->tail.load(std::memory_order_relaxed);
+		}
+
+		/*!
+		 * \brief Sync committed records and released tail to the file, from producer side
+		 *
+		 * Records are synced first, then durable head is stored and header is synced, so durable head never
+		 * points past records that are not in the file.
+		 *
+		 * \return True if sync succeeded
+		 */
+		bool flush(void)
+		{
+			uint64_t tmp_head = staged_head;
+
+			if(tmp_head != durable_head && !syncRecords(durable_head, tmp_head))
+				return false;
+
+			uint64_t tmp_tail = header->tail.load(std::memory_order_acquire);
+			header->durable_head.store(tmp_head, std::memory_order_relaxed);
+
+			if(msync(header, data_offset, MS_SYNC) != 0)
+				return false;
+
+			durable_head = tmp_head;
+			durable_tail = tmp_tail;
+			return true;
+		}
+
+		/*!
+		 * \brief Reserve contiguous space for a record, without blocking
+		 *
+		 * Reserved space is published only by writeCommit(), and can be reserved again until then.
+		 *
+		 * \param size Maximum payload size of the record in bytes
+		 * \return Pointer to payload, aligned to 8 bytes, nullptr if there is not enough contiguous space
+		 */
+		void* writeAcquire(size_t size)
+		{
+			if(size > maxRecordSize())
+				return nullptr;
+
+			reserved = layout::reserve(units, size, [this](uint64_t* hdr, size_t skipped) {
+				*hdr = recordHeader(staged_head, layout::paddingHeader(skipped), nullptr, 0);
+			});
+
+			return (reserved != nullptr) ? &reserved[1] : nullptr;
+		}
+
+		/*!
+		 * \brief Publish record reserved with writeAcquire() and flush it according to the policy
+		 * \param size Payload size in bytes, must not exceed size passed to writeAcquire()
+		 * \return False if required flush failed, record is published anyway
+		 */
+		bool writeCommit(size_t size)
+		{
+			*reserved = recordHeader(staged_head, layout::recordHeader(size), &reserved[1], size);
+			units.writeCommit(layout::recordUnits(size));
+
+			if(policy == flush_every_commit
+				|| (policy == flush_batched && (staged_head - durable_head) * sizeof(uint64_t) >= flush_interval))
+				return flush();
+
+			return true;
+		}
+
+		/*!
+		 * \brief Copy record into the journal, without blocking
+		 * \param[in] data Pointer to payload
+		 * \param size Payload size in bytes
+		 * \return True if record was inserted (and flushed if required by the policy)
+		 */
+		bool write(const void* data, size_t size)
+		{
+			void* payload = writeAcquire(size);
+
+			if(payload == nullptr)
+				return false;
+
+			memcpy(payload, data, size);
+			return writeCommit(size);
+		}
+
+		/*!
+		 * \brief Get the first record in place, without blocking
+		 *
+		 * Padding records are skipped. Record stays in the journal until released with readRelease()
+		 *
+		 * \param[out] rec Pointer to payload and its size
+		 * \return True if record was acquired
+		 */
+		bool readAcquire(record& rec)
+		{
+			uint64_t* hdr = layout::front(units);
+
+			if(hdr == nullptr)
+				return false;
+
+			rec.data = &hdr[1];
+			rec.size = layout::payloadSize(*hdr);
+			acquired_units = layout::recordUnits(rec.size);
+			return true;
+		}
+
+		/*!
+		 * \brief Release record obtained from readAcquire() back to producer
+		 */
+		void readRelease(void)
+		{
+			units.readRelease(acquired_units);
+			acquired_units = 0;
+		}
+
+	private:
+		typedef detail::RecordLayout layout;
+
+		/*!
+		 * \brief Record area as buffer of units, in the form used by detail::RecordLayout
+		 */
+		class unit_ring
+		{
+		public:
+			struct span {
+				uint64_t* data; //!< first unit of the block
+				size_t size; //!< number of units in the block
+			};
+
+			explicit unit_ring(JournalRingbuffer& owner) : journal(owner) {}
+
+			/*!
+			 * \brief Acquire free units on producer side, released units are reused only after tail was synced
+			 * \param[out] spans Blocks of free units
+			 * \param count Number of units
+			 * \return Number of acquired units, either count or 0
+			 */
+			size_t writeAcquire(span (&spans)[2], size_t count)
+			{
+				if(!journal.producerAvailable(count))
+					return 0;
+
+				getSpans(spans, journal.staged_head, count);
+				return count;
+			}
+
+			void writeCommit(size_t count) {
+				journal.staged_head += count;
+				journal.header->head.store(journal.staged_head, std::memory_order_release);
+			}
+
+			/*!
+			 * \brief Acquire published units on consumer side
+			 * \param[out] spans Blocks of published units
+			 * \param count Maximum number of units
+			 * \return Number of acquired units
+			 */
+			size_t readAcquire(span (&spans)[2], size_t count)
+			{
+				size_t avail = static_cast<size_t>(journal.cached_head - journal.staged_tail);
+
+				if(avail < count) // refresh only if cached value is not enough
+				{
+					journal.cached_head = journal.header->head.load(std::memory_order_acquire);
+					avail = static_cast<size_t>(journal.cached_head - journal.staged_tail);
+				}
+
+				if(avail < count)
+					count = avail;
+
+				getSpans(spans, journal.staged_tail, count);
+				return count;
+			}
+
+			void readRelease(size_t count) {
+				journal.staged_tail += count;
+				journal.header->tail.store(journal.staged_tail, std::memory_order_release);
+			}
+
+		private:
+			void getSpans(span (&spans)[2], uint64_t index, size_t count)
+			{
+				size_t offset = index & buffer_mask;
+				size_t linear = (count < capacity_units - offset) ? count : capacity_units - offset;
+
+				spans[0].data = &journal.data_buff[offset];
+				spans[0].size = linear;
+				spans[1].data = journal.data_buff;
+				spans[1].size = count - linear;
+			}
+
+			JournalRingbuffer& journal; //!< owner of the record area
+		};
+
+		/*!
+		 * \brief Add checksum to record header
+		 * \param position Absolute index of the record
+		 * \param hdr Header unit without checksum
+		 * \param[in] payload Payload of the record
+		 * \param size Payload size in bytes
+		 * \return Header unit, checksum in upper half
+		 */
+		uint64_t recordHeader(uint64_t position, uint64_t hdr, const void* payload, size_t size) const
+		{
+			uint32_t word = static_cast<uint32_t>(hdr);
+			uint8_t prefix[16];
+			uint32_t epoch = header_epoch;
+
+			memcpy(&prefix[0], &epoch, 4);
+			memcpy(&prefix[4], &word, 4);
+			memcpy(&prefix[8], &position, 8);
+
+			uint32_t crc = detail::crc32c(detail::crc32c(0, prefix, sizeof(prefix)), payload, size);
+			return (static_cast<uint64_t>(crc) << 32) | word;
+		}
+
+		/*!
+		 * \brief Check if there is enough space for given number of units, tail has to be synced before reuse
+		 * \param needed Number of units
+		 * \return True if there is enough space
+		 */
+		bool producerAvailable(size_t needed)
+		{
+			if(capacity_units - (staged_head - durable_tail) >= needed)
+				return true;
+
+			uint64_t tmp_tail = header->tail.load(std::memory_order_acquire);
+
+			if(tmp_tail == durable_tail || capacity_units - (staged_head - tmp_tail) < needed)
+				return false;
+
+			if(policy == flush_none)
+				durable_tail = tmp_tail;
+			else if(!flush())
+				return false;
+
+			return capacity_units - (staged_head - durable_tail) >= needed;
+		}
+
+		/*!
+		 * \brief Sync pages containing given range of units
+		 * \param from First unit index
+		 * \param to Unit index past the range
+		 * \return True if sync succeeded
+		 */
+		bool syncRecords(uint64_t from, uint64_t to)
+		{
+			size_t first = from & buffer_mask;
+			size_t count = static_cast<size_t>(to - from);
+
+			if(first + count > capacity_units) // wraps around the end
+			{
+				return syncUnits(first, capacity_units - first)
+					&& syncUnits(0, first + count - capacity_units);
+			}
+
+			return syncUnits(first, count);
+		}
+
+		bool syncUnits(size_t first, size_t count)
+		{
+			static const size_t page_size = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+
+			uintptr_t begin = reinterpret_cast<uintptr_t>(&data_buff[first]);
+			uintptr_t aligned = begin & ~(page_size - 1);
+
+			return msync(reinterpret_cast<void*>(aligned), begin - aligned + count * sizeof(uint64_t), MS_SYNC) == 0;
+		}
+
+		/*!
+		 * \brief Unmap and close the file, without flush
+		 */
+		void unmap(void)
+		{
+			if(header != nullptr)
+				munmap(header, mapping_size);
+
+			if(file_fd >= 0)
+				::close(file_fd);
+
+			header = nullptr;
+			data_buff = nullptr;
+			file_fd = -1;
+		}
+
+		/*!
+		 * \brief Check if header was never written, e.g. creator crashed in between ftruncate() and initialize()
+		 * \return True if whole header is zero
+		 */
+		bool isBlank(void) const
+		{
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(header);
+
+			for(size_t i = 0; i < sizeof(header_t); i++)
+			{
+				if(bytes[i] != 0)
+					return false;
+			}
+
+			return true;
+		}
+
+		/*!
+		 * \brief Initialize header of the new file
+		 * \return True if header was synced
+		 */
+		bool initialize(void)
+		{
+			std::atomic<uint64_t> probe(0);
+
+			if(!probe.is_lock_free()) // locks would not be placed in the file
+				return false;
+
+			new(header) header_t;
+			header->version = layout_version;
+			header->capacity = buffer_size;
+			header->cacheline = cacheline_size;
+			header->epoch = 0;
+			header->durable_head.store(0, std::memory_order_relaxed);
+			header->head.store(0, std::memory_order_relaxed);
+			header->tail.store(0, std::memory_order_relaxed);
+			header->magic.store(layout_magic, std::memory_order_release);
+
+			return startEpoch(0, 0);
+		}
+
+		/*!
+		 * \brief Validate header, extend head over intact records past durable head and start new epoch
+		 * \return True if file matches this instantiation and recovered state was synced
+		 */
+		bool recover(void)
+		{
+			if(header->magic.load(std::memory_order_acquire) != layout_magic
+				|| header->version != layout_version
+				|| header->capacity != buffer_size
+				|| header->cacheline != cacheline_size)
+				return false;
+
+			uint64_t tmp_tail = header->tail.load(std::memory_order_relaxed);
+			uint64_t tmp_head = header->durable_head.load(std::memory_order_relaxed);
+
+			if(tmp_head - tmp_tail > capacity_units) // tail was synced ahead of durable head
+				tmp_head = tmp_tail;
+
+			header_epoch = header->epoch;
+
+			for(;;)
+			{
+				size_t occupied = validRecordUnits(tmp_head, tmp_tail);
+
+				if(occupied == 0)
+					break;
+
+				tmp_head += occupied;
+			}
+
+			return startEpoch(tmp_head, tmp_tail);
+		}
+
+		/*!
+		 * \brief Check record at given index
+		 * \param position Absolute index of the record
+		 * \param tmp_tail Current tail index
+		 * \return Number of units occupied by the record, 0 if record is torn, stale or doesn't fit
+		 */
+		size_t validRecordUnits(uint64_t position, uint64_t tmp_tail) const
+		{
+			size_t offset = position & buffer_mask;
+			uint64_t hdr = data_buff[offset];
+			bool padding = layout::isPadding(hdr);
+			size_t size = padding ? 0 : layout::payloadSize(hdr);
+			size_t occupied = layout::occupiedUnits(hdr);
+
+			if(padding ? (offset + occupied != capacity_units) : (size > maxRecordSize() || offset + occupied > capacity_units))
+				return 0;
+
+			if(position + occupied - tmp_tail > capacity_units)
+				return 0;
+
+			if(recordHeader(position, hdr, &data_buff[offset + 1], size) != hdr)
+				return 0;
+
+			return occupied;
+		}
+
+		/*!
+		 * \brief Sync recovered state and increment epoch, records of interrupted runs past head become stale
+		 * \param tmp_head Recovered head index
+		 * \param tmp_tail Recovered tail index
+		 * \return True if header was synced
+		 */
+		bool startEpoch(uint64_t tmp_head, uint64_t tmp_tail)
+		{
+			header->head.store(tmp_head, std::memory_order_relaxed);
+			header->durable_head.store(tmp_head, std::memory_order_relaxed);
+			header->tail.store(tmp_tail, std::memory_order_relaxed);
+			header->epoch = header_epoch + 1;
+
+			if(msync(header, data_offset, MS_SYNC) != 0)
+				return false;
+
+			header_epoch = header->epoch;
+			staged_head = durable_head = tmp_head;
+			durable_tail = staged_tail = cached_head = tmp_tail;
+			acquired_units = 0;
+			return true;
+		}
+
+		constexpr static size_t capacity_units = buffer_size / sizeof(uint64_t); //!< number of units in record area
+		constexpr static uint64_t buffer_mask = capacity_units - 1; //!< bitwise mask for a given buffer size
+		constexpr static size_t data_offset = 65536; //!< offset of record area, keeps header in its own page
+		constexpr static size_t mapping_size = data_offset + buffer_size; //!< size of the whole file
+
+		header_t* header; //!< beginning of the mapping
+		uint64_t* data_buff; //!< record area
+		int file_fd; //!< journal file descriptor
+		uint32_t header_epoch; //!< epoch of the current run
+
+		flush_policy policy; //!< producer side flush policy
+		size_t flush_interval; //!< bytes committed between flushes with flush_batched policy
+		uint64_t staged_head; //!< producer side head index
+		uint64_t durable_head; //!< producer side copy of synced head index
+		uint64_t durable_tail; //!< producer side copy of synced tail index
+		uint64_t* reserved; //!< header of reserved record, producer side only
+
+		alignas(cacheline_size) uint64_t staged_tail; //!< consumer side tail index
+		uint64_t cached_head; //!< consumer side copy of head index
+		size_t acquired_units; //!< units of acquired record, consumer side only
+
+		unit_ring units; //!< record area accessor for detail::RecordLayout
+
+		static_assert(buffer_size >= 2 * sizeof(uint64_t), "buffer must hold at least one record header and payload unit");
+		static_assert((buffer_size & (buffer_size - 1)) == 0, "buffer size is not a power of 2");
+		static_assert(buffer_size <= (static_cast<size_t>(1) << 31), "record size has to fit in header");
+		static_assert(sizeof(header_t) <= data_offset, "header doesn't fit in front of record area");
+	};
+
+} // namespace
+
+#endif //RINGBUFFER_JOURNAL_HPP
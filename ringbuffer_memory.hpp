@@ -0,0 +1,270 @@
+/*!
+ * \file ringbuffer_memory.hpp
+ * \brief Linux specific memory backends for ExternalRingbuffer
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_MEMORY_HPP
+#define RINGBUFFER_MEMORY_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace jnk0le
+{
+	/*!
+	 * \brief Memory mapped twice back to back, so the end of the buffer continues into its beginning
+	 *
+	 * When ExternalRingbuffer is placed in this memory, blocks returned by writeAcquire() and readAcquire() can be
+	 * accessed through the first block pointer for the whole acquired count, without handling wrap around.
+	 * Capacity of the ring (size / sizeof(T)) must fill the memory exactly, so sizeof(T) has to be a power of 2.
+	 *
+	 * \code
+	 * jnk0le::MirroredMemory mem;
+	 * if(!mem.allocate(1 << 20))
+	 *     return; // not supported or out of memory
+	 *
+	 * jnk0le::ExternalRingbuffer<uint8_t> rb(mem.data(), mem.size());
+	 * \endcode
+	 */
+	class MirroredMemory
+	{
+	public:
+		MirroredMemory() : area(nullptr), area_size(0) {}
+		~MirroredMemory() { release(); }
+
+		MirroredMemory(const MirroredMemory&) = delete;
+		MirroredMemory& operator=(const MirroredMemory&) = delete;
+
+		/*!
+		 * \brief Create mirrored mapping, previous one is released
+		 * \param size Size of the memory in bytes, must be a power of 2 and multiple of page size
+		 * \return True if memory was mapped
+		 */
+		bool allocate(size_t size)
+		{
+			release();
+
+			long page_size = sysconf(_SC_PAGESIZE);
+
+			if(size == 0 || (size & (size - 1)) != 0 || page_size <= 0 || (size % page_size) != 0)
+				return false;
+
+			int fd = memfd_create("ringbuffer", MFD_CLOEXEC);
+
+			if(fd < 0)
+				return false;
+
+			if(ftruncate(fd, size) != 0)
+			{
+				close(fd);
+				return false;
+			}
+
+			// reserve continuous address space first, so both views can be placed next to each other
+			void* reserved = mmap(nullptr, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if(reserved == MAP_FAILED)
+			{
+				close(fd);
+				return false;
+			}
+
+			uint8_t* base = static_cast<uint8_t*>(reserved);
+			void* lower = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+			void* upper = mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0);
+
+			close(fd); // mappings keep the memory alive
+
+			if(lower == MAP_FAILED || upper == MAP_FAILED)
+			{
+				munmap(reserved, 2 * size);
+				return false;
+			}
+
+			area = base;
+			area_size = size;
+			return true;
+		}
+
+		/*!
+		 * \brief Unmap memory, buffer placed in it must not be used anymore
+		 */
+		void release(void)
+		{
+			if(area != nullptr)
+				munmap(area, 2 * area_size);
+
+			area = nullptr;
+			area_size = 0;
+		}
+
+		/*!
+		 * \brief Get pointer to the first view
+		 * \return Pointer to mapped memory, nullptr if not allocated
+		 */
+		void* data(void) const {
+			return area;
+		}
+
+		/*!
+		 * \brief Get size of single view
+		 * \return Size of the memory in bytes
+		 */
+		size_t size(void) const {
+			return area_size;
+		}
+
+	private:
+		uint8_t* area; //!< first of the two consecutive views
+		size_t area_size; //!< size of a single view
+	};
+
+	/*!
+	 * \brief Memory backed by 2MB huge pages, faulted in at allocation time
+	 *
+	 * Explicit huge pages (MAP_HUGETLB) are used if the system has them reserved, otherwise memory is aligned to
+	 * huge page boundary and advised for transparent huge pages. All pages are touched, and optionally locked, at
+	 * allocation, so the first pass over the buffer does not take page faults in the hot path.
+	 *
+	 * \code
+	 * jnk0le::HugePageMemory mem;
+	 * if(!mem.allocate(64 << 20))
+	 *     return; // out of memory or RLIMIT_MEMLOCK too low
+	 *
+	 * jnk0le::ExternalRingbuffer<packet> rb(mem.data(), mem.size() / sizeof(packet));
+	 * \endcode
+	 */
+	class HugePageMemory
+	{
+	public:
+		constexpr static size_t huge_page_size = 2 * 1024 * 1024; //!< size of huge page assumed by the allocator
+
+		HugePageMemory() : area(nullptr), area_size(0), huge_tlb(false) {}
+		~HugePageMemory() { release(); }
+
+		HugePageMemory(const HugePageMemory&) = delete;
+		HugePageMemory& operator=(const HugePageMemory&) = delete;
+
+		/*!
+		 * \brief Allocate and pre fault memory, previous one is released
+		 * \param size Size of the memory in bytes, rounded up to multiple of huge page size
+		 * \param lock Lock pages in memory with mlock()
+		 * \return True if memory was allocated (and locked if requested)
+		 */
+		bool allocate(size_t size, bool lock = true)
+		{
+			release();
+
+			if(size == 0)
+				return false;
+
+			size = (size + huge_page_size - 1) & ~(huge_page_size - 1);
+
+			void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+
+			huge_tlb = (mem != MAP_FAILED);
+
+			if(!huge_tlb) // fall back to transparent huge pages
+			{
+				mem = mapAligned(size);
+
+				if(mem == nullptr)
+					return false;
+
+				madvise(mem, size, MADV_HUGEPAGE);
+			}
+
+			area = static_cast<uint8_t*>(mem);
+			area_size = size;
+
+			// fault in every page now, instead of on the first write from the producer
+			memset(area, 0, area_size);
+
+			if(lock && mlock(area, area_size) != 0)
+			{
+				release();
+				return false;
+			}
+
+			return true;
+		}
+
+		/*!
+		 * \brief Free memory, buffer placed in it must not be used anymore
+		 */
+		void release(void)
+		{
+			if(area != nullptr)
+				munmap(area, area_size); // also unlocks
+
+			area = nullptr;
+			area_size = 0;
+			huge_tlb = false;
+		}
+
+		/*!
+		 * \brief Get pointer to the memory
+		 * \return Pointer to allocated memory, nullptr if not allocated
+		 */
+		void* data(void) const {
+			return area;
+		}
+
+		/*!
+		 * \brief Get size of the memory
+		 * \return Size of the memory in bytes
+		 */
+		size_t size(void) const {
+			return area_size;
+		}
+
+		/*!
+		 * \brief Check if memory is backed by explicit (MAP_HUGETLB) huge pages
+		 * \return True if explicit huge pages are used, false if transparent huge pages were requested
+		 */
+		bool isHugeTlb(void) const {
+			return huge_tlb;
+		}
+
+	private:
+		/*!
+		 * \brief Map anonymous memory aligned to huge page size
+		 * \param size Size of the memory, multiple of huge page size
+		 * \return Pointer to aligned memory, nullptr if mapping failed
+		 */
+		static void* mapAligned(size_t size)
+		{
+			void* mem = mmap(nullptr, size + huge_page_size, PROT_READ | PROT_WRITE,
+					MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+			if(mem == MAP_FAILED)
+				return nullptr;
+
+			uint8_t* raw = static_cast<uint8_t*>(mem);
+			uint8_t* aligned = reinterpret_cast<uint8_t*>(
+					(reinterpret_cast<uintptr_t>(raw) + huge_page_size - 1) & ~(huge_page_size - 1));
+
+			// trim excess at both ends
+			if(aligned != raw)
+				munmap(raw, aligned - raw);
+
+			if(aligned + size != raw + size + huge_page_size)
+				munmap(aligned + size, (raw + size + huge_page_size) - (aligned + size));
+
+			return aligned;
+		}
+
+		uint8_t* area; //!< allocated memory
+		size_t area_size; //!< size of allocated memory
+		bool huge_tlb; //!< memory comes from explicit huge pages
+	};
+
+} // namespace
+
+#endif //RINGBUFFER_MEMORY_HPP
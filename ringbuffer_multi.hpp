@@ -0,0 +1,1112 @@
+/*!
+ * \file ringbuffer_multi.hpp
+ * \brief Multi producer and multi consumer ring buffer implementations
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_MULTI_HPP
+#define RINGBUFFER_MULTI_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits>
+#include <atomic>
+#include <type_traits>
+#include <new>
+#include <utility>
+
+namespace jnk0le
+{
+	namespace detail
+	{
+		/*!
+		 * \brief Index and slot storage of ring buffers publishing elements with per slot sequence numbers
+		 *
+		 * Sequence number of a slot equals position that can be written into it, position + 1 once element at
+		 * that position is published, and position + buffer_size after it was consumed.
+		 * Storage is trivially destructible unless T requires destructor to be called on leftover elements.
+		 */
+		template<typename T, size_t buffer_size, size_t cacheline_size, typename index_t,
+			bool trivially_destructible = std::is_trivially_destructible<T>::value>
+		class SequencedStorage
+		{
+		protected:
+			SequencedStorage() : head(0), tail(0) {
+				for(size_t i = 0; i < buffer_size; i++)
+					slots[i].seq.store(i, std::memory_order_relaxed);
+			}
+
+			/*!
+			 * \brief Element storage with sequence number
+			 */
+			struct slot_t {
+				std::atomic<index_t> seq; //!< sequence number
+				typename std::aligned_storage<sizeof(T), alignof(T)>::type data; //!< element, uninitialized
+			};
+
+			slot_t& slot(index_t index) {
+				return slots[index & buffer_mask];
+			}
+
+			static T* item(slot_t& s) {
+				return reinterpret_cast<T*>(&s.data);
+			}
+
+			constexpr static index_t buffer_mask = buffer_size-1; //!< bitwise mask for a given buffer size
+
+			alignas(cacheline_size) std::atomic<index_t> head; //!< head index
+			alignas(cacheline_size) std::atomic<index_t> tail; //!< tail index
+
+			alignas(cacheline_size) slot_t slots[buffer_size]; //!< actual buffer
+
+			// let's assert that no UB will be compiled in
+			static_assert((buffer_size != 0), "buffer cannot be of zero size");
+			static_assert((buffer_size & buffer_mask) == 0, "buffer size is not a power of 2");
+			static_assert(sizeof(index_t) <= sizeof(size_t),
+				"indexing type size is larger than size_t, operation is not lock free and doesn't make sense");
+
+			static_assert(std::numeric_limits<index_t>::is_integer, "indexing type is not integral type");
+			static_assert(!(std::numeric_limits<index_t>::is_signed), "indexing type must not be signed");
+			static_assert(buffer_mask <= ((std::numeric_limits<index_t>::max)() >> 1),
+				"buffer size is too large for a given indexing type (maximum size for n-bit type is 2^(n-1))");
+		};
+
+		template<typename T, size_t buffer_size, size_t cacheline_size, typename index_t>
+		class SequencedStorage<T, buffer_size, cacheline_size, index_t, false>
+			: public SequencedStorage<T, buffer_size, cacheline_size, index_t, true>
+		{
+		protected:
+			~SequencedStorage() {
+				index_t tmp_head = this->head.load(std::memory_order_relaxed);
+
+				for(index_t i = this->tail.load(std::memory_order_relaxed); i != tmp_head; i++)
+				{
+					typename SequencedStorage::slot_t& s = this->slot(i);
+
+					if(s.seq.load(std::memory_order_relaxed) == static_cast<index_t>(i + 1)) // published, not consumed
+						this->item(s)->~T();
+				}
+			}
+		};
+
+		/*!
+		 * \brief Cursors and element storage of ring buffers with multiple consumer cursors
+		 *
+		 * Elements in between reclaim index and head are alive, they are destroyed by producer once all consumers
+		 * moved past them. Storage is trivially destructible unless T requires destructor to be called on leftover elements.
+		 */
+		template<typename T, size_t buffer_size, size_t consumers, size_t cacheline_size, typename index_t,
+			bool trivially_destructible = std::is_trivially_destructible<T>::value>
+		class BroadcastStorage
+		{
+		protected:
+			BroadcastStorage() : head(0), reclaim(0), cached_tail(0) {
+				for(size_t i = 0; i < consumers; i++)
+				{
+					cursors[i].tail.store(0, std::memory_order_relaxed);
+					cursors[i].cached_head = 0;
+				}
+			}
+
+			/*!
+			 * \brief Consumer side index, padded to separate cache line
+			 */
+			struct alignas(cacheline_size) cursor_t {
+				std::atomic<index_t> tail; //!< tail index of the consumer
+				index_t cached_head; //!< shadow head, consumer side only
+			};
+
+			T* slot(index_t index) {
+				return reinterpret_cast<T*>(&data_buff[index & buffer_mask]);
+			}
+
+			constexpr static index_t buffer_mask = buffer_size-1; //!< bitwise mask for a given buffer size
+
+			alignas(cacheline_size) std::atomic<index_t> head; //!< head index
+			alignas(cacheline_size) index_t reclaim; //!< all elements before this index are destroyed, producer side only
+			index_t cached_tail; //!< shadow tail of the slowest consumer, producer side only
+
+			cursor_t cursors[consumers]; //!< consumer cursors
+
+			alignas(cacheline_size) typename std::aligned_storage<sizeof(T), alignof(T)>::type data_buff[buffer_size]; //!< actual buffer
+
+			// let's assert that no UB will be compiled in
+			static_assert((buffer_size != 0), "buffer cannot be of zero size");
+			static_assert((buffer_size & buffer_mask) == 0, "buffer size is not a power of 2");
+			static_assert((consumers != 0), "at least one consumer is required");
+			static_assert(sizeof(index_t) <= sizeof(size_t),
+				"indexing type size is larger than size_t, operation is not lock free and doesn't make sense");
+
+			static_assert(std::numeric_limits<index_t>::is_integer, "indexing type is not integral type");
+			static_assert(!(std::numeric_limits<index_t>::is_signed), "indexing type must not be signed");
+			static_assert(buffer_mask <= ((std::numeric_limits<index_t>::max)() >> 1),
+				"buffer size is too large for a given indexing type (maximum size for n-bit type is 2^(n-1))");
+		};
+
+		template<typename T, size_t buffer_size, size_t consumers, size_t cacheline_size, typename index_t>
+		class BroadcastStorage<T, buffer_size, consumers, cacheline_size, index_t, false>
+			: public BroadcastStorage<T, buffer_size, consumers, cacheline_size, index_t, true>
+		{
+		protected:
+			~BroadcastStorage() {
+				index_t tmp_head = this->head.load(std::memory_order_relaxed);
+
+				for(index_t i = this->reclaim; i != tmp_head; i++)
+					this->slot(i)->~T();
+			}
+		};
+	} // namespace detail
+
+	/*!
+	 * \brief Lock free ringbuffer implementation, with single or multiple producers and consumers
+	 *
+	 * Every slot is published and freed through its own sequence number. Multiple producers (or consumers) claim
+	 * batches of consecutive slots with a single CAS on head (or tail) index, so a slow thread doesn't block others
+	 * from claiming and the CAS contention is amortized over the whole batch. Single side doesn't use any atomic
+	 * read-modify-write operations.
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam multi_producer Allow concurrent calls of producer side functions
+	 * \tparam multi_consumer Allow concurrent calls of consumer side functions
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size, bool multi_producer, bool multi_consumer,
+		bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	class SequencedRingbuffer : private detail::SequencedStorage<T, buffer_size, cacheline_size, index_t>
+	{
+		typedef detail::SequencedStorage<T, buffer_size, cacheline_size, index_t> storage;
+		typedef typename storage::slot_t slot_t;
+
+	public:
+		/*!
+		 * \brief Default constructor, will initialize indexes and slot sequence numbers
+		 */
+		SequencedRingbuffer() {}
+
+		/*!
+		 * \brief Clear buffer from consumer side
+		 *
+		 * Only elements inserted before the call are removed, so it terminates even if producers keep inserting.
+		 * Stops early at the first slot that was claimed but not published yet.
+		 */
+		void consumerClear(void)
+		{
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+
+			for(;;)
+			{
+				diff_t left = static_cast<diff_t>(static_cast<index_t>(tmp_head - tail.load(std::memory_order_relaxed)));
+
+				if(left <= 0 || remove(static_cast<size_t>(left)) == 0)
+					break;
+			}
+		}
+
+		/*!
+		 * \brief Check if buffer is empty
+		 * \return True if buffer is empty
+		 */
+		bool isEmpty(void) const {
+			return readAvailable() == 0;
+		}
+
+		/*!
+		 * \brief Check if buffer is full
+		 * \return True if buffer is full
+		 */
+		bool isFull(void) const {
+			return writeAvailable() == 0;
+		}
+
+		/*!
+		 * \brief Check how many elements can be read from the buffer
+		 * \return Number of slots claimed by producers and not claimed by consumers, some of them may not be
+		 * published yet
+		 */
+		index_t readAvailable(void) const {
+			return claimed();
+		}
+
+		/*!
+		 * \brief Check how many elements can be written into the buffer
+		 * \return Number of slots that are not claimed by producers, some of them may not be freed by consumers yet
+		 */
+		index_t writeAvailable(void) const {
+			return buffer_size - claimed();
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param data element to be copied into internal buffer
+		 * \return True if data was inserted
+		 */
+		bool insert(const T& data) {
+			return emplace(data);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param data element to be moved into internal buffer, left untouched if there is no space
+		 * \return True if data was inserted
+		 */
+		bool insert(T&& data) {
+			return emplace(std::move(data));
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param[in] data Pointer to memory location where element, to be inserted into internal buffer, is located
+		 * \return True if data was inserted
+		 */
+		bool insert(const T* data) {
+			return emplace(*data);
+		}
+
+		/*!
+		 * \brief Constructs element in place inside internal buffer, without blocking
+		 * \param args Arguments forwarded to the constructor of T
+		 * \return True if element was constructed
+		 */
+		template<typename... Args>
+		bool emplace(Args&&... args)
+		{
+			index_t pos;
+
+			if(claim<multi_producer>(head, pos, 1, 0) == 0)
+				return false;
+
+			slot_t& s = slot(pos);
+
+			new(item(s)) T(std::forward<Args>(args)...);
+			std::atomic_signal_fence(std::memory_order_release);
+			s.seq.store(pos + 1, index_release_barrier);
+			return true;
+		}
+
+		/*!
+		 * \brief Insert multiple elements into internal buffer without blocking
+		 *
+		 * This function will claim as many consecutive free slots as possible at once and insert data from given
+		 * buffer.
+		 *
+		 * \param[in] buff Pointer to buffer with data to be inserted from
+		 * \param count Number of elements to write from the given buffer
+		 * \return Number of elements written into internal buffer
+		 */
+		size_t writeBuff(const T* buff, size_t count)
+		{
+			index_t pos;
+			size_t to_write = claim<multi_producer>(head, pos, count, 0);
+
+			for(size_t i = 0; i < to_write; i++)
+				new(item(slot(pos + i))) T(buff[i]);
+
+			// do not publish slots before all of them are constructed
+			std::atomic_signal_fence(std::memory_order_release);
+			std::atomic_thread_fence(index_release_barrier);
+
+			for(size_t i = 0; i < to_write; i++)
+				slot(pos + i).seq.store(pos + i + 1, std::memory_order_relaxed);
+
+			return to_write;
+		}
+
+		/*!
+		 * \brief Removes single element without reading
+		 * \return True if one element was removed
+		 */
+		bool remove() {
+			return remove(1) == 1;
+		}
+
+		/*!
+		 * \brief Removes multiple elements without reading and storing it elsewhere
+		 * \param cnt Maximum number of elements to remove
+		 * \return Number of removed elements
+		 */
+		size_t remove(size_t cnt) {
+			return consume(nullptr, cnt);
+		}
+
+		/*!
+		 * \brief Reads one element from internal buffer without blocking
+		 * \param[out] data Reference to memory location where removed element will be stored
+		 * \return True if data was fetched from the internal buffer
+		 */
+		bool remove(T& data) {
+			return remove(&data); // references are anyway implemented as pointers
+		}
+
+		/*!
+		 * \brief Reads one element from internal buffer without blocking
+		 * \param[out] data Pointer to memory location where removed element will be stored
+		 * \return True if data was fetched from the internal buffer
+		 */
+		bool remove(T* data) {
+			return consume(data, 1) == 1;
+		}
+
+		/*!
+		 * \brief Gets the first element in the buffer on consumed side, available only with single consumer
+		 *
+		 * It is safe to use and modify item contents only on consumer side
+		 *
+		 * \return Pointer to first element, nullptr if buffer was empty or first element is not published yet
+		 */
+		T* peek() {
+			static_assert(!multi_consumer, "first element can be claimed by other consumer at any time");
+
+			index_t tmp_tail = tail.load(std::memory_order_relaxed);
+			slot_t& s = slot(tmp_tail);
+
+			if(s.seq.load(index_acquire_barrier) != static_cast<index_t>(tmp_tail + 1))
+				return nullptr;
+			else
+				return item(s);
+		}
+
+		/*!
+		 * \brief Load multiple elements from internal buffer without blocking
+		 *
+		 * This function will claim as many consecutive published elements as possible, up to specified amount,
+		 * at once and load them into given buffer.
+		 *
+		 * \param[out] buff Pointer to buffer where data will be loaded into
+		 * \param count Number of elements to load into the given buffer
+		 * \return Number of elements that were read from internal buffer
+		 */
+		size_t readBuff(T* buff, size_t count) {
+			return consume(buff, count);
+		}
+
+	private:
+		typedef typename std::make_signed<index_t>::type diff_t;
+
+		/*!
+		 * \brief Get number of slots claimed by producers and not claimed by consumers
+		 *
+		 * Tail is loaded first, so consumers claiming in between can't move it past the head snapshot. Result is
+		 * clamped to buffer size, as producers can claim slots freed after the tail snapshot.
+		 *
+		 * \return Number of claimed slots, in range [0, buffer_size]
+		 */
+		index_t claimed(void) const
+		{
+			index_t tmp_tail = tail.load(std::memory_order_acquire);
+			diff_t used = static_cast<diff_t>(static_cast<index_t>(head.load(std::memory_order_relaxed) - tmp_tail));
+
+			if(used <= 0)
+				return 0;
+
+			return (static_cast<size_t>(used) < buffer_size) ? static_cast<index_t>(used) : buffer_size;
+		}
+
+		/*!
+		 * \brief Claim consecutive slots that are in expected state
+		 *
+		 * \tparam multi Index is shared with other threads and has to be advanced with CAS
+		 * \param index Head or tail index
+		 * \param[out] pos Position of the first claimed slot
+		 * \param count Maximum number of slots to claim
+		 * \param seq_offset Expected difference between slot sequence number and its position,
+		 * 0 for free slots, 1 for published elements
+		 * \return Number of claimed slots
+		 */
+		template<bool multi>
+		size_t claim(std::atomic<index_t>& index, index_t& pos, size_t count, index_t seq_offset)
+		{
+			index_t tmp = index.load(std::memory_order_relaxed);
+
+			for(;;)
+			{
+				size_t n = 0;
+				diff_t diff = 0;
+
+				for(; n < count && n < buffer_size; n++)
+				{
+					index_t expected = tmp + n + seq_offset;
+					diff = static_cast<diff_t>(static_cast<index_t>(slot(tmp + n).seq.load(index_acquire_barrier) - expected));
+
+					if(diff != 0)
+						break;
+				}
+
+				if(n == 0)
+				{
+					if(multi && diff > 0) // other thread claimed it in the meantime
+					{
+						tmp = index.load(std::memory_order_relaxed);
+						continue;
+					}
+
+					return 0; // slot not yet freed or published by the opposite side
+				}
+
+				if(!multi)
+					index.store(tmp + n, std::memory_order_relaxed);
+				else if(!index.compare_exchange_weak(tmp, tmp + n, std::memory_order_relaxed, std::memory_order_relaxed))
+					continue;
+
+				pos = tmp;
+				return n;
+			}
+		}
+
+		/*!
+		 * \brief Claim, move out and free consecutive published elements
+		 * \param[out] buff Pointer to buffer where data will be loaded into, nullptr to drop elements
+		 * \param count Maximum number of elements to consume
+		 * \return Number of consumed elements
+		 */
+		size_t consume(T* buff, size_t count)
+		{
+			index_t pos;
+			size_t read = claim<multi_consumer>(tail, pos, count, 1);
+
+			for(size_t i = 0; i < read; i++)
+			{
+				T* element = item(slot(pos + i));
+
+				if(buff != nullptr)
+					buff[i] = std::move(*element);
+
+				element->~T();
+			}
+
+			// do not free slots before all operations on them committed
+			std::atomic_signal_fence(std::memory_order_release);
+			std::atomic_thread_fence(index_release_barrier);
+
+			for(size_t i = 0; i < read; i++)
+				slot(pos + i).seq.store(pos + i + buffer_size, std::memory_order_relaxed);
+
+			return read;
+		}
+
+		constexpr static std::memory_order index_acquire_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_acquire; // do not load from, or store to slot before confirmed by the opposite side
+		constexpr static std::memory_order index_release_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_release; // do not hand over slot before all operations on it committed
+
+		using storage::head;
+		using storage::tail;
+		using storage::slot;
+		using storage::item;
+	};
+
+	/*!
+	 * \brief Lock free, multi producer single consumer ringbuffer
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	using MpscRingbuffer = SequencedRingbuffer<T, buffer_size, true, false, fake_tso, cacheline_size, index_t>;
+
+	/*!
+	 * \brief Lock free, single producer multi consumer ringbuffer, consumers claim batches of elements
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	using SpmcRingbuffer = SequencedRingbuffer<T, buffer_size, false, true, fake_tso, cacheline_size, index_t>;
+
+	/*!
+	 * \brief Lock free, bounded multi producer multi consumer ringbuffer
+	 *
+	 * There is no lock, nor global counter other than head and tail claiming indexes. Consumer can't skip slot claimed
+	 * by a producer that is not yet published, so remove() may fail on non empty buffer until that producer finishes.
+	 * Narrow index_t wraps around quickly under heavy contention, use at least 32 bit one with many threads.
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	using MpmcRingbuffer = SequencedRingbuffer<T, buffer_size, true, true, fake_tso, cacheline_size, index_t>;
+
+	/*!
+	 * \brief Lock free broadcast ringbuffer, where every element written by single producer is read by all consumers
+	 *
+	 * Elements are written once, each consumer has its own tail cursor and reads them in place or copies them out.
+	 * Producer is gated by the slowest consumer. Consumers are identified by index in range [0, consumers) and each
+	 * of them must be accessed from a single thread at a time.
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam consumers Number of consumers
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size = 16, size_t consumers = 2, bool fake_tso = false,
+		size_t cacheline_size = 0, typename index_t = size_t>
+	class BroadcastRingbuffer : private detail::BroadcastStorage<T, buffer_size, consumers, cacheline_size, index_t>
+	{
+		typedef detail::BroadcastStorage<T, buffer_size, consumers, cacheline_size, index_t> storage;
+
+	public:
+		/*!
+		 * \brief Default constructor, will initialize head and all consumer cursors
+		 */
+		BroadcastRingbuffer() {}
+
+		/*!
+		 * \brief Clear buffer from the consumer side, other consumers are not affected
+		 * \param consumer Index of the consumer
+		 */
+		void consumerClear(size_t consumer) {
+			cursors[consumer].tail.store(head.load(index_acquire_barrier), index_release_barrier);
+		}
+
+		/*!
+		 * \brief Check if buffer is empty for the consumer
+		 * \param consumer Index of the consumer
+		 * \return True if buffer is empty
+		 */
+		bool isEmpty(size_t consumer) const {
+			return readAvailable(consumer) == 0;
+		}
+
+		/*!
+		 * \brief Check if buffer is full, from producer side
+		 * \return True if buffer is full for the slowest consumer
+		 */
+		bool isFull(void) const {
+			return writeAvailable() == 0;
+		}
+
+		/*!
+		 * \brief Check how many elements can be read from the buffer by the consumer
+		 * \param consumer Index of the consumer
+		 * \return Number of elements that can be read
+		 */
+		index_t readAvailable(size_t consumer) const {
+			return head.load(index_acquire_barrier) - cursors[consumer].tail.load(std::memory_order_relaxed);
+		}
+
+		/*!
+		 * \brief Check how many elements can be written into the buffer, from producer side
+		 * \return Number of free slots that can be written, limited by the slowest consumer
+		 */
+		index_t writeAvailable(void) const {
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+			return buffer_size - (tmp_head - slowestTail(tmp_head));
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param data element to be copied into internal buffer
+		 * \return True if data was inserted
+		 */
+		bool insert(const T& data) {
+			return emplace(data);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param data element to be moved into internal buffer, left untouched if there is no space
+		 * \return True if data was inserted
+		 */
+		bool insert(T&& data) {
+			return emplace(std::move(data));
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param[in] data Pointer to memory location where element, to be inserted into internal buffer, is located
+		 * \return True if data was inserted
+		 */
+		bool insert(const T* data) {
+			return emplace(*data);
+		}
+
+		/*!
+		 * \brief Constructs element in place inside internal buffer, without blocking
+		 * \param args Arguments forwarded to the constructor of T
+		 * \return True if element was constructed
+		 */
+		template<typename... Args>
+		bool emplace(Args&&... args)
+		{
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+
+			if(producerAvailable(tmp_head, 1) == 0)
+				return false;
+
+			new(slot(tmp_head)) T(std::forward<Args>(args)...);
+
+			std::atomic_signal_fence(std::memory_order_release);
+			head.store(tmp_head + 1, index_release_barrier);
+			return true;
+		}
+
+		/*!
+		 * \brief Insert multiple elements into internal buffer without blocking
+		 *
+		 * This function will insert as much data as possible from given buffer.
+		 *
+		 * \param[in] buff Pointer to buffer with data to be inserted from
+		 * \param count Number of elements to write from the given buffer
+		 * \return Number of elements written into internal buffer
+		 */
+		size_t writeBuff(const T* buff, size_t count)
+		{
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+			size_t to_write = producerAvailable(tmp_head, count);
+
+			for(size_t i = 0; i < to_write; i++)
+				new(slot(tmp_head + i)) T(buff[i]);
+
+			std::atomic_signal_fence(std::memory_order_release);
+			head.store(tmp_head + to_write, index_release_barrier);
+			return to_write;
+		}
+
+		/*!
+		 * \brief Removes single element without reading
+		 * \param consumer Index of the consumer
+		 * \return True if one element was removed
+		 */
+		bool remove(size_t consumer) {
+			return remove(consumer, static_cast<size_t>(1)) == 1;
+		}
+
+		/*!
+		 * \brief Removes multiple elements without reading and storing it elsewhere
+		 * \param consumer Index of the consumer
+		 * \param cnt Maximum number of elements to remove
+		 * \return Number of removed elements
+		 */
+		size_t remove(size_t consumer, size_t cnt)
+		{
+			index_t tmp_tail = cursors[consumer].tail.load(std::memory_order_relaxed);
+			size_t avail = consumerAvailable(consumer, tmp_tail, cnt);
+
+			std::atomic_signal_fence(std::memory_order_release);
+			cursors[consumer].tail.store(tmp_tail + avail, index_release_barrier); // release in case data was loaded/used before
+			return avail;
+		}
+
+		/*!
+		 * \brief Reads one element from internal buffer without blocking
+		 * \param consumer Index of the consumer
+		 * \param[out] data Reference to memory location where element will be copied
+		 * \return True if data was fetched from the internal buffer
+		 */
+		bool remove(size_t consumer, T& data) {
+			return remove(consumer, &data); // references are anyway implemented as pointers
+		}
+
+		/*!
+		 * \brief Reads one element from internal buffer without blocking
+		 * \param consumer Index of the consumer
+		 * \param[out] data Pointer to memory location where element will be copied
+		 * \return True if data was fetched from the internal buffer
+		 */
+		bool remove(size_t consumer, T* data) {
+			return readBuff(consumer, data, 1) == 1;
+		}
+
+		/*!
+		 * \brief Gets the first element in the buffer for the consumer
+		 *
+		 * Element is shared with other consumers, so it must not be modified
+		 *
+		 * \param consumer Index of the consumer
+		 * \return Pointer to first element, nullptr if buffer was empty
+		 */
+		const T* peek(size_t consumer)
+		{
+			index_t tmp_tail = cursors[consumer].tail.load(std::memory_order_relaxed);
+
+			if(consumerAvailable(consumer, tmp_tail, 1) == 0)
+				return nullptr;
+			else
+				return slot(tmp_tail);
+		}
+
+		/*!
+		 * \brief Load multiple elements from internal buffer without blocking
+		 *
+		 * This function will copy as many elements as possible, up to specified amount.
+		 *
+		 * \param consumer Index of the consumer
+		 * \param[out] buff Pointer to buffer where data will be copied into
+		 * \param count Number of elements to load into the given buffer
+		 * \return Number of elements that were read from internal buffer
+		 */
+		size_t readBuff(size_t consumer, T* buff, size_t count)
+		{
+			index_t tmp_tail = cursors[consumer].tail.load(std::memory_order_relaxed);
+			size_t to_read = consumerAvailable(consumer, tmp_tail, count);
+
+			for(size_t i = 0; i < to_read; i++)
+				buff[i] = *slot(tmp_tail + i);
+
+			std::atomic_signal_fence(std::memory_order_release);
+			cursors[consumer].tail.store(tmp_tail + to_read, index_release_barrier);
+			return to_read;
+		}
+
+	private:
+		/*!
+		 * \brief Get tail of the consumer that is the furthest behind head
+		 * \param tmp_head Current head index
+		 * \return Tail index of the slowest consumer
+		 */
+		index_t slowestTail(index_t tmp_head) const
+		{
+			index_t used = 0;
+
+			for(size_t i = 0; i < consumers; i++)
+			{
+				index_t tmp = tmp_head - cursors[i].tail.load(index_acquire_barrier);
+
+				if(tmp > used)
+					used = tmp;
+			}
+
+			return tmp_head - used;
+		}
+
+		/*!
+		 * \brief Get number of slots that can be written, slots released by all consumers are reclaimed when
+		 * cached tail does not leave enough space
+		 * \param tmp_head Current head index
+		 * \param count Number of slots requested
+		 * \return Number of slots that can be written, up to count
+		 */
+		size_t producerAvailable(index_t tmp_head, size_t count)
+		{
+			index_t used = tmp_head - cached_tail; // calculate in index_t, it may be promoted to int otherwise
+			size_t avail = buffer_size - used;
+
+			if(avail < count) // scan all consumers only if cached value is not enough
+			{
+				cached_tail = slowestTail(tmp_head);
+				used = tmp_head - cached_tail;
+				avail = buffer_size - used;
+
+				for(; reclaim != cached_tail; reclaim++)
+					slot(reclaim)->~T();
+			}
+
+			return (avail < count) ? avail : count;
+		}
+
+		/*!
+		 * \brief Get number of elements that can be read by the consumer
+		 * \param consumer Index of the consumer
+		 * \param tmp_tail Current tail index of the consumer
+		 * \param count Number of elements requested
+		 * \return Number of elements that can be read, up to count
+		 */
+		size_t consumerAvailable(size_t consumer, index_t tmp_tail, size_t count)
+		{
+			index_t& cached_head = cursors[consumer].cached_head;
+			size_t avail = static_cast<index_t>(cached_head - tmp_tail); // may be promoted to int otherwise
+
+			if(avail < count || avail > buffer_size) // cached head is stale after consumerClear()
+			{
+				cached_head = head.load(index_acquire_barrier);
+				avail = static_cast<index_t>(cached_head - tmp_tail);
+			}
+
+			return (avail < count) ? avail : count;
+		}
+
+		constexpr static std::memory_order index_acquire_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_acquire; // do not load from, or store to buffer before confirmed by the opposite side
+		constexpr static std::memory_order index_release_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_release; // do not update own side before all operations on data_buff committed
+
+		using storage::head;
+		using storage::reclaim;
+		using storage::cached_tail;
+		using storage::cursors;
+		using storage::slot;
+	};
+
+	/*!
+	 * \brief Lock free ringbuffer, where elements pass through a chain of processing stages in place
+	 *
+	 * Single producer inserts elements, each stage then processes (and may modify) them in place and releases them
+	 * to the next stage. Stage is identified by index in range [0, stages), stage 0 consumes after producer and
+	 * every next stage only up to where previous one has released. Producer is gated by the last stage.
+	 * Each stage must be accessed from a single thread at a time.
+	 *
+	 * \code
+	 * jnk0le::PipelineRingbuffer<message, 1024, 2> rb;
+	 * jnk0le::PipelineRingbuffer<message, 1024, 2>::span spans[2];
+	 *
+	 * size_t cnt = rb.readAcquire(0, spans); // enrich stage
+	 * for(size_t i = 0; i < spans[0].size; i++)
+	 *     enrich(spans[0].data[i]);
+	 * for(size_t i = 0; i < spans[1].size; i++)
+	 *     enrich(spans[1].data[i]);
+	 * rb.readRelease(0, cnt); // hand over to publish stage
+	 * \endcode
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam stages Number of processing stages
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size = 16, size_t stages = 2, bool fake_tso = false,
+		size_t cacheline_size = 0, typename index_t = size_t>
+	class PipelineRingbuffer : private detail::BroadcastStorage<T, buffer_size, stages, cacheline_size, index_t>
+	{
+		typedef detail::BroadcastStorage<T, buffer_size, stages, cacheline_size, index_t> storage;
+
+	public:
+		/*!
+		 * \brief Continuous block of elements
+		 */
+		struct span {
+			T* data; //!< pointer to first element
+			size_t size; //!< number of elements
+		};
+
+		/*!
+		 * \brief Default constructor, will initialize head and all stage cursors
+		 */
+		PipelineRingbuffer() {}
+
+		/*!
+		 * \brief Check if there are no elements released to the stage
+		 * \param stage Index of the stage
+		 * \return True if stage has nothing to process
+		 */
+		bool isEmpty(size_t stage) const {
+			return readAvailable(stage) == 0;
+		}
+
+		/*!
+		 * \brief Check if buffer is full, from producer side
+		 * \return True if buffer is full
+		 */
+		bool isFull(void) const {
+			return writeAvailable() == 0;
+		}
+
+		/*!
+		 * \brief Check how many elements are released to the stage by the previous one
+		 * \param stage Index of the stage
+		 * \return Number of elements that can be processed
+		 */
+		index_t readAvailable(size_t stage) const {
+			return upstream(stage).load(index_acquire_barrier) - cursors[stage].tail.load(std::memory_order_relaxed);
+		}
+
+		/*!
+		 * \brief Check how many elements can be written into the buffer, from producer side
+		 * \return Number of slots released by the last stage
+		 */
+		index_t writeAvailable(void) const {
+			return buffer_size - (head.load(std::memory_order_relaxed) - cursors[stages - 1].tail.load(index_acquire_barrier));
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param data element to be copied into internal buffer
+		 * \return True if data was inserted
+		 */
+		bool insert(const T& data) {
+			return emplace(data);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param data element to be moved into internal buffer, left untouched if there is no space
+		 * \return True if data was inserted
+		 */
+		bool insert(T&& data) {
+			return emplace(std::move(data));
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, without blocking
+		 * \param[in] data Pointer to memory location where element, to be inserted into internal buffer, is located
+		 * \return True if data was inserted
+		 */
+		bool insert(const T* data) {
+			return emplace(*data);
+		}
+
+		/*!
+		 * \brief Constructs element in place inside internal buffer, without blocking
+		 * \param args Arguments forwarded to the constructor of T
+		 * \return True if element was constructed
+		 */
+		template<typename... Args>
+		bool emplace(Args&&... args)
+		{
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+
+			if(producerAvailable(tmp_head, 1) == 0)
+				return false;
+
+			new(slot(tmp_head)) T(std::forward<Args>(args)...);
+
+			std::atomic_signal_fence(std::memory_order_release);
+			head.store(tmp_head + 1, index_release_barrier);
+			return true;
+		}
+
+		/*!
+		 * \brief Insert multiple elements into internal buffer without blocking
+		 *
+		 * This function will insert as much data as possible from given buffer.
+		 *
+		 * \param[in] buff Pointer to buffer with data to be inserted from
+		 * \param count Number of elements to write from the given buffer
+		 * \return Number of elements written into internal buffer
+		 */
+		size_t writeBuff(const T* buff, size_t count)
+		{
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+			size_t to_write = producerAvailable(tmp_head, count);
+
+			for(size_t i = 0; i < to_write; i++)
+				new(slot(tmp_head + i)) T(buff[i]);
+
+			std::atomic_signal_fence(std::memory_order_release);
+			head.store(tmp_head + to_write, index_release_barrier);
+			return to_write;
+		}
+
+		/*!
+		 * \brief Gets the first element to be processed by the stage
+		 *
+		 * It is safe to use and modify item contents only from the given stage, until it is released
+		 *
+		 * \param stage Index of the stage
+		 * \return Pointer to first element, nullptr if there is nothing to process
+		 */
+		T* peek(size_t stage)
+		{
+			index_t tmp_tail = cursors[stage].tail.load(std::memory_order_relaxed);
+
+			if(stageAvailable(stage, tmp_tail, 1) == 0)
+				return nullptr;
+			else
+				return slot(tmp_tail);
+		}
+
+		/*!
+		 * \brief Get direct access to elements to be processed by the stage
+		 *
+		 * Elements can be modified in place. Second span is non empty only if block wraps around the end of the buffer.
+		 *
+		 * \param stage Index of the stage
+		 * \param[out] spans Blocks of elements to be processed
+		 * \param count Maximum number of elements to acquire
+		 * \return Total number of acquired elements
+		 */
+		size_t readAcquire(size_t stage, span (&spans)[2], size_t count = (std::numeric_limits<size_t>::max)())
+		{
+			index_t tmp_tail = cursors[stage].tail.load(std::memory_order_relaxed);
+			size_t avail = stageAvailable(stage, tmp_tail, count);
+			size_t linear = buffer_size - (tmp_tail & buffer_mask);
+
+			if(linear > avail)
+				linear = avail;
+
+			spans[0].data = slot(tmp_tail);
+			spans[0].size = linear;
+			spans[1].data = slot(0);
+			spans[1].size = avail - linear;
+
+			return avail;
+		}
+
+		/*!
+		 * \brief Release processed elements to the next stage, or to the producer from the last stage
+		 * \param stage Index of the stage
+		 * \param count Number of elements to release, must not exceed number returned from readAcquire() or
+		 * readAvailable()
+		 */
+		void readRelease(size_t stage, size_t count)
+		{
+			index_t tmp_tail = cursors[stage].tail.load(std::memory_order_relaxed);
+
+			std::atomic_signal_fence(std::memory_order_release);
+			cursors[stage].tail.store(tmp_tail + count, index_release_barrier);
+		}
+
+	private:
+		/*!
+		 * \brief Get index guarding the stage
+		 * \param stage Index of the stage
+		 * \return Head index for the first stage, tail of the previous stage otherwise
+		 */
+		const std::atomic<index_t>& upstream(size_t stage) const {
+			return (stage == 0) ? head : cursors[stage - 1].tail;
+		}
+
+		/*!
+		 * \brief Get number of slots that can be written, slots released by the last stage are reclaimed when
+		 * cached tail does not leave enough space
+		 * \param tmp_head Current head index
+		 * \param count Number of slots requested
+		 * \return Number of slots that can be written, up to count
+		 */
+		size_t producerAvailable(index_t tmp_head, size_t count)
+		{
+			index_t used = tmp_head - cached_tail; // calculate in index_t, it may be promoted to int otherwise
+			size_t avail = buffer_size - used;
+
+			if(avail < count) // refresh only if cached value is not enough
+			{
+				cached_tail = cursors[stages - 1].tail.load(index_acquire_barrier);
+				used = tmp_head - cached_tail;
+				avail = buffer_size - used;
+
+				for(; reclaim != cached_tail; reclaim++)
+					slot(reclaim)->~T();
+			}
+
+			return (avail < count) ? avail : count;
+		}
+
+		/*!
+		 * \brief Get number of elements that can be processed by the stage
+		 * \param stage Index of the stage
+		 * \param tmp_tail Current tail index of the stage
+		 * \param count Number of elements requested
+		 * \return Number of elements that can be processed, up to count
+		 */
+		size_t stageAvailable(size_t stage, index_t tmp_tail, size_t count)
+		{
+			index_t& cached_head = cursors[stage].cached_head;
+			size_t avail = static_cast<index_t>(cached_head - tmp_tail); // may be promoted to int otherwise
+
+			if(avail < count) // refresh only if cached value is not enough
+			{
+				cached_head = upstream(stage).load(index_acquire_barrier);
+				avail = static_cast<index_t>(cached_head - tmp_tail);
+			}
+
+			return (avail < count) ? avail : count;
+		}
+
+		constexpr static std::memory_order index_acquire_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_acquire; // do not access elements before released by the previous stage
+		constexpr static std::memory_order index_release_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_release; // do not release elements before all operations on them committed
+
+		using storage::buffer_mask;
+		using storage::head;
+		using storage::reclaim;
+		using storage::cached_tail;
+		using storage::cursors;
+		using storage::slot;
+	};
+
+} // namespace
+
+#endif //RINGBUFFER_MULTI_HPP
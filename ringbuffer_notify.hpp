@@ -0,0 +1,221 @@
+/*!
+ * \file ringbuffer_notify.hpp
+ * \brief Ringbuffer wrapper notifying opposite side about available data or space
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_NOTIFY_HPP
+#define RINGBUFFER_NOTIFY_HPP
+
+#include <stddef.h>
+#include <utility>
+
+#include "ringbuffer.hpp"
+
+namespace jnk0le
+{
+	namespace detail
+	{
+		/*!
+		 * \brief Ringbuffer wrapper, that passes every operation making data or space available to a notifier
+		 *
+		 * Operations that could make space or data available without notifying (e.g. insertNoPublish() before publish(),
+		 * or consumed elements held back by setReleaseInterval()) are exposed only through notifying wrappers.
+		 *
+		 * \tparam Notifier Type with notify() member, called after data or space was made available
+		 */
+		template<typename T, size_t buffer_size, bool fake_tso, size_t cacheline_size, typename index_t, typename Notifier>
+		class NotifyingRingbuffer : private Ringbuffer<T, buffer_size, fake_tso, cacheline_size, index_t>
+		{
+		protected:
+			typedef Ringbuffer<T, buffer_size, fake_tso, cacheline_size, index_t> ringbuffer;
+
+		public:
+			using typename ringbuffer::span;
+			using ringbuffer::capacity;
+			using ringbuffer::isEmpty;
+			using ringbuffer::isFull;
+			using ringbuffer::readAvailable;
+			using ringbuffer::consumerReadAvailable;
+			using ringbuffer::writeAvailable;
+			using ringbuffer::producerWriteAvailable;
+			using ringbuffer::insertNoPublish;
+			using ringbuffer::emplaceNoPublish;
+			using ringbuffer::writeAcquire;
+			using ringbuffer::readAcquire;
+			using ringbuffer::peek;
+			using ringbuffer::at;
+			using ringbuffer::operator[];
+			using ringbuffer::setReleaseInterval;
+			using ringbuffer::producerClear; // space waiter is the producer itself, nothing to notify
+
+			/*!
+			 * \brief Clear buffer from consumer side and notify producer
+			 */
+			void consumerClear(void) {
+				ringbuffer::consumerClear();
+				space_notifier.notify();
+			}
+
+			/*!
+			 * \brief Inserts data into internal buffer, without blocking
+			 * \param data element to be copied into internal buffer
+			 * \return True if data was inserted
+			 */
+			bool insert(const T& data) {
+				return emplace(data);
+			}
+
+			/*!
+			 * \brief Inserts data into internal buffer, without blocking
+			 * \param data element to be moved into internal buffer, left untouched if there is no space
+			 * \return True if data was inserted
+			 */
+			bool insert(T&& data) {
+				return emplace(std::move(data));
+			}
+
+			/*!
+			 * \brief Inserts data into internal buffer, without blocking
+			 * \param[in] data Pointer to memory location where element, to be inserted into internal buffer, is located
+			 * \return True if data was inserted
+			 */
+			bool insert(const T* data) {
+				return emplace(*data);
+			}
+
+			/*!
+			 * \brief Constructs element in place inside internal buffer, without blocking
+			 * \param args Arguments forwarded to the constructor of T
+			 * \return True if element was constructed
+			 */
+			template<typename... Args>
+			bool emplace(Args&&... args)
+			{
+				bool inserted = ringbuffer::emplace(std::forward<Args>(args)...);
+
+				if(inserted)
+					data_notifier.notify();
+
+				return inserted;
+			}
+
+			/*!
+			 * \brief Publish elements inserted with insertNoPublish() and notify consumer
+			 */
+			void publish(void) {
+				ringbuffer::publish();
+				data_notifier.notify();
+			}
+
+			/*!
+			 * \brief Publish slots written in place after writeAcquire() and notify consumer
+			 * \param count Number of slots to publish
+			 */
+			void writeCommit(size_t count) {
+				ringbuffer::writeCommit(count);
+				data_notifier.notify();
+			}
+
+			/*!
+			 * \brief Insert multiple elements into internal buffer without blocking
+			 * \param[in] buff Pointer to buffer with data to be inserted from
+			 * \param count Number of elements to write from the given buffer
+			 * \return Number of elements written into internal buffer
+			 */
+			size_t writeBuff(const T* buff, size_t count)
+			{
+				size_t written = ringbuffer::writeBuff(buff, count);
+
+				if(written != 0)
+					data_notifier.notify();
+
+				return written;
+			}
+
+			/*!
+			 * \brief Removes single element without reading
+			 * \return True if one element was removed
+			 */
+			bool remove() {
+				return notifySpace(ringbuffer::remove());
+			}
+
+			/*!
+			 * \brief Removes multiple elements without reading and storing it elsewhere
+			 * \param cnt Maximum number of elements to remove
+			 * \return Number of removed elements
+			 */
+			size_t remove(size_t cnt) {
+				return notifySpace(ringbuffer::remove(cnt));
+			}
+
+			/*!
+			 * \brief Reads one element from internal buffer without blocking
+			 * \param[out] data Reference to memory location where removed element will be stored
+			 * \return True if data was fetched from the internal buffer
+			 */
+			bool remove(T& data) {
+				return remove(&data); // references are anyway implemented as pointers
+			}
+
+			/*!
+			 * \brief Reads one element from internal buffer without blocking
+			 * \param[out] data Pointer to memory location where removed element will be stored
+			 * \return True if data was fetched from the internal buffer
+			 */
+			bool remove(T* data) {
+				return notifySpace(ringbuffer::remove(data));
+			}
+
+			/*!
+			 * \brief Release elements obtained from readAcquire() and notify producer
+			 * \param count Number of elements to release, must not exceed number of acquired elements
+			 */
+			void readRelease(size_t count) {
+				ringbuffer::readRelease(count);
+				space_notifier.notify();
+			}
+
+			/*!
+			 * \brief Release all consumed elements back to producer immediately and notify producer
+			 */
+			void releaseTail(void) {
+				ringbuffer::releaseTail();
+				space_notifier.notify();
+			}
+
+			/*!
+			 * \brief Load multiple elements from internal buffer without blocking
+			 * \param[out] buff Pointer to buffer where data will be loaded into
+			 * \param count Number of elements to load into the given buffer
+			 * \return Number of elements that were read from internal buffer
+			 */
+			size_t readBuff(T* buff, size_t count) {
+				return notifySpace(ringbuffer::readBuff(buff, count));
+			}
+
+		protected:
+			/*!
+			 * \brief Notify producer if consumer operation succeeded
+			 * \param result Result of the operation
+			 * \return Unmodified result
+			 */
+			template<typename Result>
+			Result notifySpace(Result result)
+			{
+				if(result)
+					space_notifier.notify();
+
+				return result;
+			}
+
+			alignas(cacheline_size) Notifier data_notifier; //!< notified when data is made available to consumer
+			alignas(cacheline_size) Notifier space_notifier; //!< notified when space is made available to producer
+		};
+	} // namespace detail
+
+} // namespace
+
+#endif //RINGBUFFER_NOTIFY_HPP
@@ -0,0 +1,246 @@
+/*!
+ * \file ringbuffer_overwrite.hpp
+ * \brief Lossy SPSC ring buffer, overwriting oldest elements when full
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_OVERWRITE_HPP
+#define RINGBUFFER_OVERWRITE_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <limits>
+#include <atomic>
+#include <type_traits>
+
+namespace jnk0le
+{
+	/*!
+	 * \brief Lock free SPSC ringbuffer, where producer never blocks and overwrites the oldest elements instead
+	 *
+	 * Producer doesn't look at the consumer side at all. Every slot carries a sequence number, so the consumer
+	 * can detect elements that were overwritten before or during read and skip them. Skipped elements are
+	 * accounted in droppedCount().
+	 * Elements are copied out while producer may be writing the same slot (seqlock), so T must be trivially copyable.
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2, at least 2.
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	class OverwritingRingbuffer
+	{
+	public:
+		/*!
+		 * \brief Default constructor, will initialize indexes and slot sequence numbers
+		 */
+		OverwritingRingbuffer() : head(0), tail(0), dropped(0) {
+			for(size_t i = 0; i < buffer_size; i++)
+				slots[i].seq.store(0, std::memory_order_relaxed);
+		}
+
+		/*!
+		 * \brief Special case constructor to premature out unnecessary initialization code when object is
+		 * instantiated in .bss section
+		 * \warning If object is instantiated on stack, heap or inside noinit section then the contents have to be
+		 * explicitly cleared before use
+		 * \param dummy Ignored
+		 */
+		OverwritingRingbuffer(int dummy) { (void)(dummy); }
+
+		/*!
+		 * \brief Clear buffer from consumer side
+		 */
+		void consumerClear(void) {
+			tail = head.load(std::memory_order_relaxed);
+		}
+
+		/*!
+		 * \brief Check if buffer is empty, from consumer side
+		 * \return True if buffer is empty
+		 */
+		bool isEmpty(void) const {
+			return readAvailable() == 0;
+		}
+
+		/*!
+		 * \brief Check how many elements can be read from the buffer, from consumer side
+		 * \return Number of elements that can be read, some of them may be overwritten before read
+		 */
+		index_t readAvailable(void) const {
+			index_t avail = head.load(index_acquire_barrier) - tail;
+			return (avail > buffer_size) ? buffer_size : avail;
+		}
+
+		/*!
+		 * \brief Get number of elements that were overwritten before consumer managed to read them
+		 * \return Number of dropped elements, counted on consumer side
+		 */
+		size_t droppedCount(void) const {
+			return dropped;
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, overwriting the oldest element if buffer is full
+		 * \param data element to be inserted into internal buffer
+		 */
+		void insert(const T& data)
+		{
+			index_t tmp_head = head.load(std::memory_order_relaxed);
+			slot_t& item = slots[tmp_head & buffer_mask];
+
+			// invalidate slot before it is modified
+			item.seq.store(tmp_head, std::memory_order_relaxed);
+			std::atomic_signal_fence(std::memory_order_release);
+			std::atomic_thread_fence(index_release_barrier);
+
+			item.data = data;
+
+			item.seq.store(tmp_head + 1, index_release_barrier);
+			head.store(tmp_head + 1, index_release_barrier);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, overwriting the oldest element if buffer is full
+		 * \param[in] data Pointer to memory location where element, to be inserted into internal buffer, is located
+		 */
+		void insert(const T* data) {
+			insert(*data);
+		}
+
+		/*!
+		 * \brief Insert multiple elements into internal buffer, overwriting the oldest elements if buffer is full
+		 * \param[in] buff Pointer to buffer with data to be inserted from
+		 * \param count Number of elements to write from the given buffer
+		 */
+		void writeBuff(const T* buff, size_t count) {
+			for(size_t i = 0; i < count; i++)
+				insert(buff[i]);
+		}
+
+		/*!
+		 * \brief Reads one element from internal buffer without blocking
+		 *
+		 * Elements overwritten by producer are skipped and added to droppedCount()
+		 *
+		 * \param[out] data Reference to memory location where removed element will be stored
+		 * \return True if data was fetched from the internal buffer
+		 */
+		bool remove(T& data) {
+			return remove(&data);
+		}
+
+		/*!
+		 * \brief Reads one element from internal buffer without blocking
+		 *
+		 * Elements overwritten by producer are skipped and added to droppedCount()
+		 *
+		 * \param[out] data Pointer to memory location where removed element will be stored
+		 * \return True if data was fetched from the internal buffer
+		 */
+		bool remove(T* data)
+		{
+			index_t tmp_tail = tail;
+
+			for(;;)
+			{
+				index_t avail = head.load(index_acquire_barrier) - tmp_tail;
+
+				if(avail == 0)
+					break;
+
+				if(avail > buffer_size) // producer lapped consumer, jump to the oldest element still in buffer
+				{
+					dropped += avail - buffer_size;
+					tmp_tail += avail - buffer_size;
+				}
+
+				slot_t& item = slots[tmp_tail & buffer_mask];
+				index_t seq = item.seq.load(index_acquire_barrier);
+
+				if(seq == static_cast<index_t>(tmp_tail + 1))
+				{
+					T tmp = item.data;
+
+					std::atomic_signal_fence(std::memory_order_acquire);
+					std::atomic_thread_fence(index_acquire_barrier);
+
+					if(item.seq.load(std::memory_order_relaxed) == seq) // not overwritten during read
+					{
+						*data = tmp;
+						tail = tmp_tail + 1;
+						return true;
+					}
+				}
+
+				// slot is being (or was) overwritten with newer element
+				dropped++;
+				tmp_tail++;
+			}
+
+			tail = tmp_tail;
+			return false;
+		}
+
+		/*!
+		 * \brief Load multiple elements from internal buffer without blocking
+		 *
+		 * Elements overwritten by producer are skipped and added to droppedCount()
+		 *
+		 * \param[out] buff Pointer to buffer where data will be loaded into
+		 * \param count Number of elements to load into the given buffer
+		 * \return Number of elements that were read from internal buffer
+		 */
+		size_t readBuff(T* buff, size_t count)
+		{
+			size_t read = 0;
+
+			while(read < count && remove(&buff[read]))
+				read++;
+
+			return read;
+		}
+
+	private:
+		/*!
+		 * \brief Element storage with sequence number of the last write
+		 */
+		struct slot_t {
+			std::atomic<index_t> seq; //!< index + 1 of completed write, index of write in progress
+			T data; //!< element
+		};
+
+		constexpr static index_t buffer_mask = buffer_size-1; //!< bitwise mask for a given buffer size
+		constexpr static std::memory_order index_acquire_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_acquire; // do not load from buffer before confirmed by the producer
+		constexpr static std::memory_order index_release_barrier = fake_tso ?
+				  std::memory_order_relaxed
+				: std::memory_order_release; // do not publish before all operations on slot committed
+
+		alignas(cacheline_size) std::atomic<index_t> head; //!< head index
+		alignas(cacheline_size) index_t tail; //!< tail index, consumer side only
+		size_t dropped; //!< number of overwritten elements, consumer side only
+
+		alignas(cacheline_size) slot_t slots[buffer_size]; //!< actual buffer
+
+		// let's assert that no UB will be compiled in
+		static_assert((buffer_size >= 2), "buffer must hold at least 2 elements");
+		static_assert((buffer_size & buffer_mask) == 0, "buffer size is not a power of 2");
+		static_assert(sizeof(index_t) <= sizeof(size_t),
+			"indexing type size is larger than size_t, operation is not lock free and doesn't make sense");
+
+		static_assert(std::numeric_limits<index_t>::is_integer, "indexing type is not integral type");
+		static_assert(!(std::numeric_limits<index_t>::is_signed), "indexing type must not be signed");
+		static_assert(buffer_mask <= ((std::numeric_limits<index_t>::max)() >> 1),
+			"buffer size is too large for a given indexing type (maximum size for n-bit type is 2^(n-1))");
+
+		static_assert(std::is_trivially_copyable<T>::value, "elements are copied while being overwritten");
+	};
+
+} // namespace
+
+#endif //RINGBUFFER_OVERWRITE_HPP
@@ -0,0 +1,305 @@
+/*!
+ * \file ringbuffer_record.hpp
+ * \brief Variable length record SPSC ring buffer
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_RECORD_HPP
+#define RINGBUFFER_RECORD_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "ringbuffer.hpp"
+
+namespace jnk0le
+{
+	namespace detail
+	{
+		/*!
+		 * \brief Layout of variable length records stored in 8 byte units, shared by record based buffers
+		 *
+		 * Header unit holds payload size shifted left by one, with padding flag in the lowest bit, in its lower
+		 * 32 bits. Upper 32 bits are zero or used for checksum. Padding record covers the space skipped at the end
+		 * of the buffer, so every record is contiguous.
+		 */
+		struct RecordLayout
+		{
+			typedef uint64_t unit_t; //!< storage unit, also record header
+
+			/*!
+			 * \brief Get number of units occupied by record with header
+			 * \param size Payload size in bytes
+			 * \return Number of units
+			 */
+			constexpr static size_t recordUnits(size_t size) {
+				return 1 + (size + sizeof(unit_t) - 1) / sizeof(unit_t);
+			}
+
+			/*!
+			 * \brief Build header of the record
+			 * \param size Payload size in bytes
+			 * \return Header unit, without checksum
+			 */
+			constexpr static unit_t recordHeader(size_t size) {
+				return static_cast<uint32_t>(size << 1);
+			}
+
+			/*!
+			 * \brief Build header of padding record
+			 * \param units Number of skipped units, including header
+			 * \return Header unit, without checksum
+			 */
+			constexpr static unit_t paddingHeader(size_t units) {
+				return static_cast<uint32_t>(((units - 1) << 1) | 1);
+			}
+
+			constexpr static bool isPadding(unit_t hdr) {
+				return (hdr & 1) != 0;
+			}
+
+			constexpr static size_t payloadSize(unit_t hdr) {
+				return static_cast<uint32_t>(hdr) >> 1;
+			}
+
+			/*!
+			 * \brief Get number of units occupied by record or padding
+			 * \param hdr Header unit
+			 * \return Number of units
+			 */
+			constexpr static size_t occupiedUnits(unit_t hdr) {
+				return isPadding(hdr) ? payloadSize(hdr) + 1 : recordUnits(payloadSize(hdr));
+			}
+
+			/*!
+			 * \brief Reserve contiguous units for a record, publishing padding record if it would straddle the wrap
+			 * \param units Buffer of units, with writeAcquire(span (&)[2], count) and writeCommit(count)
+			 * \param size Payload size in bytes
+			 * \param write_padding Callable storing padding header, as void(unit_t* hdr, size_t units)
+			 * \return Pointer to header of the reserved record, nullptr if there is not enough contiguous space
+			 */
+			template<typename Units, typename Padding>
+			static unit_t* reserve(Units& units, size_t size, Padding&& write_padding)
+			{
+				typename Units::span spans[2];
+				size_t needed = recordUnits(size);
+
+				if(units.writeAcquire(spans, needed) != needed)
+					return nullptr;
+
+				if(spans[1].size != 0) // would straddle the wrap, skip the rest of the buffer
+				{
+					write_padding(spans[0].data, spans[0].size);
+					units.writeCommit(spans[0].size);
+
+					if(units.writeAcquire(spans, needed) != needed)
+						return nullptr;
+				}
+
+				return spans[0].data;
+			}
+
+			/*!
+			 * \brief Get the first record, releasing padding records in front of it
+			 * \param units Buffer of units, with readAcquire(span (&)[2], count) and readRelease(count)
+			 * \return Pointer to header of the record, nullptr if there is none
+			 */
+			template<typename Units>
+			static unit_t* front(Units& units)
+			{
+				typename Units::span spans[2];
+
+				for(;;)
+				{
+					if(units.readAcquire(spans, 1) == 0)
+						return nullptr;
+
+					if(!isPadding(spans[0].data[0]))
+						return spans[0].data;
+
+					units.readRelease(occupiedUnits(spans[0].data[0]));
+				}
+			}
+		};
+	} // namespace detail
+
+	/*!
+	 * \brief Lock free SPSC ringbuffer of variable length records, each of them contiguous in memory
+	 *
+	 * Records are stored in 8 byte units, as a header unit with length followed by payload. If record doesn't fit
+	 * before the end of the buffer, the remaining space is published as padding record (skipped by consumer)
+	 * and the record is placed at the beginning.
+	 * Payload is aligned to 8 bytes and is accessed in place on both sides.
+	 *
+	 * \code
+	 * jnk0le::RecordRingbuffer<65536> rb;
+	 *
+	 * // producer
+	 * void* p = rb.writeAcquire(sizeof(order_event));
+	 * if(p != nullptr)
+	 * {
+	 *     new(p) order_event(...);
+	 *     rb.writeCommit(sizeof(order_event));
+	 * }
+	 *
+	 * // consumer
+	 * jnk0le::RecordRingbuffer<65536>::record rec;
+	 * while(rb.readAcquire(rec))
+	 * {
+	 *     dispatch(rec.data, rec.size);
+	 *     rb.readRelease();
+	 * }
+	 * \endcode
+	 *
+	 * \tparam buffer_size Size of the buffer in bytes. Must be a power of 2, at least 16.
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<size_t buffer_size = 4096, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	class RecordRingbuffer
+	{
+	public:
+		/*!
+		 * \brief Record acquired on consumer side
+		 */
+		struct record {
+			void* data; //!< pointer to payload, aligned to 8 bytes
+			size_t size; //!< payload size in bytes
+		};
+
+		/*!
+		 * \brief Default constructor, will initialize head and tail indexes
+		 */
+		RecordRingbuffer() : reserved(nullptr), acquired_units(0) {}
+
+		/*!
+		 * \brief Get maximum payload size of a single record
+		 * \return Size in bytes
+		 */
+		constexpr static size_t maxRecordSize(void) {
+			return buffer_size - sizeof(unit_t);
+		}
+
+		/*!
+		 * \brief Clear buffer from consumer side
+		 */
+		void consumerClear(void) {
+			acquired_units = 0;
+			units.consumerClear();
+		}
+
+		/*!
+		 * \brief Check if buffer is empty
+		 * \return True if buffer is empty
+		 */
+		bool isEmpty(void) const {
+			return units.isEmpty();
+		}
+
+		/*!
+		 * \brief Check how many bytes of the buffer are free, can be called only from producer side
+		 * \return Number of free bytes, record of that size may not fit due to header, alignment or wrap around
+		 */
+		size_t writeAvailable(void) const {
+			return units.producerWriteAvailable() * sizeof(unit_t);
+		}
+
+		/*!
+		 * \brief Reserve contiguous space for a record, without blocking
+		 *
+		 * Reserved space is published only by writeCommit(), and can be reserved again until then.
+		 *
+		 * \param size Maximum payload size of the record in bytes
+		 * \return Pointer to payload, aligned to 8 bytes, nullptr if there is not enough contiguous space
+		 */
+		void* writeAcquire(size_t size)
+		{
+			if(size > maxRecordSize())
+				return nullptr;
+
+			reserved = layout::reserve(units, size, [](unit_t* hdr, size_t skipped) {
+				*hdr = layout::paddingHeader(skipped);
+			});
+
+			return (reserved != nullptr) ? &reserved[1] : nullptr;
+		}
+
+		/*!
+		 * \brief Publish record reserved with writeAcquire()
+		 * \param size Payload size in bytes, must not exceed size passed to writeAcquire()
+		 */
+		void writeCommit(size_t size)
+		{
+			reserved[0] = layout::recordHeader(size);
+			units.writeCommit(layout::recordUnits(size));
+		}
+
+		/*!
+		 * \brief Copy record into the buffer, without blocking
+		 * \param[in] data Pointer to payload
+		 * \param size Payload size in bytes
+		 * \return True if record was inserted
+		 */
+		bool write(const void* data, size_t size)
+		{
+			void* payload = writeAcquire(size);
+
+			if(payload == nullptr)
+				return false;
+
+			memcpy(payload, data, size);
+			writeCommit(size);
+			return true;
+		}
+
+		/*!
+		 * \brief Get the first record in place, without blocking
+		 *
+		 * Padding records are skipped. Record stays in the buffer until released with readRelease()
+		 *
+		 * \param[out] rec Pointer to payload and its size
+		 * \return True if record was acquired
+		 */
+		bool readAcquire(record& rec)
+		{
+			unit_t* hdr = layout::front(units);
+
+			if(hdr == nullptr)
+				return false;
+
+			rec.data = &hdr[1];
+			rec.size = layout::payloadSize(*hdr);
+			acquired_units = layout::recordUnits(rec.size);
+			return true;
+		}
+
+		/*!
+		 * \brief Release record obtained from readAcquire() back to producer
+		 */
+		void readRelease(void)
+		{
+			units.readRelease(acquired_units);
+			acquired_units = 0;
+		}
+
+	private:
+		typedef detail::RecordLayout layout;
+		typedef layout::unit_t unit_t;
+
+		typedef Ringbuffer<unit_t, buffer_size / sizeof(unit_t), fake_tso, cacheline_size, index_t> unit_ringbuffer;
+
+		unit_ringbuffer units; //!< buffer of units
+		alignas(cacheline_size) unit_t* reserved; //!< header of reserved record, producer side only
+		alignas(cacheline_size) size_t acquired_units; //!< units of acquired record, consumer side only
+
+		static_assert(buffer_size >= 2 * sizeof(unit_t), "buffer must hold at least one record header and payload unit");
+		static_assert((buffer_size & (buffer_size - 1)) == 0, "buffer size is not a power of 2");
+		static_assert(buffer_size <= (static_cast<size_t>(1) << 31), "record size has to fit in header");
+	};
+
+} // namespace
+
+#endif //RINGBUFFER_RECORD_HPP
@@ -0,0 +1,312 @@
+/*!
+ * \file ringbuffer_shm.hpp
+ * \brief POSIX shared memory placement of Ringbuffer, for SPSC communication between processes
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_SHM_HPP
+#define RINGBUFFER_SHM_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ringbuffer.hpp"
+
+namespace jnk0le
+{
+	/*!
+	 * \brief Ringbuffer placed in shared memory after a versioned header
+	 *
+	 * Static size Ringbuffer keeps indexes and elements inline, so it doesn't contain any pointers and can be mapped
+	 * at different addresses in each process. Header describes the layout (capacity, element size, cache line and
+	 * index size), so attach() rejects memory created with a different instantiation.
+	 * One process is a producer and the other one is a consumer, exactly as with threads.
+	 *
+	 * \code
+	 * // feed handler
+	 * jnk0le::SharedRingbuffer<tick, 4096, false, 64> shm;
+	 * if(!shm.create("/ticks"))
+	 *     return;
+	 * shm->insert(t);
+	 *
+	 * // strategy
+	 * jnk0le::SharedRingbuffer<tick, 4096, false, 64> shm;
+	 * if(!shm.attach("/ticks"))
+	 *     return;
+	 * shm->remove(t);
+	 * \endcode
+	 *
+	 * \tparam T Type of buffered elements, must be trivially copyable
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	class SharedRingbuffer
+	{
+	public:
+		typedef Ringbuffer<T, buffer_size, fake_tso, cacheline_size, index_t> ringbuffer;
+
+		constexpr static uint32_t layout_magic = 0x4a524253; //!< "JRBS", marks initialized header
+		constexpr static uint32_t layout_version = 1; //!< incremented on incompatible change of header or Ringbuffer layout
+
+		/*!
+		 * \brief Description of the shared memory layout, placed at the beginning of the mapping
+		 */
+		struct header_t {
+			std::atomic<uint32_t> magic; //!< layout_magic, stored last by creator
+			uint32_t version; //!< layout_version of the creator
+			uint64_t capacity; //!< number of elements
+			uint32_t element_size; //!< sizeof(T)
+			uint32_t element_alignment; //!< alignof(T)
+			uint32_t cacheline; //!< cacheline_size template parameter
+			uint32_t index_size; //!< sizeof(index_t)
+			uint32_t barriers; //!< fake_tso template parameter, both sides have to generate the same barriers
+			uint32_t data_offset; //!< offset of Ringbuffer object from the beginning of the mapping
+		};
+
+		SharedRingbuffer() : header(nullptr), rb(nullptr), shm_fd(-1) {}
+		~SharedRingbuffer() { detach(); }
+
+		SharedRingbuffer(const SharedRingbuffer&) = delete;
+		SharedRingbuffer& operator=(const SharedRingbuffer&) = delete;
+
+		/*!
+		 * \brief Create named shared memory object and initialize buffer in it, previous mapping is detached
+		 * \param name Name of the shared memory object, as in shm_open(), must not exist
+		 * \param mode Permissions of the created object
+		 * \return True if buffer was created
+		 */
+		bool create(const char* name, mode_t mode = 0600)
+		{
+			detach();
+
+			int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, mode);
+
+			if(fd < 0)
+				return false;
+
+			if(!initialize(fd))
+			{
+				shm_unlink(name);
+				return false;
+			}
+
+			return true;
+		}
+
+		/*!
+		 * \brief Create anonymous shared memory and initialize buffer in it, previous mapping is detached
+		 *
+		 * Descriptor returned by fd() can be passed to the other process (e.g. inherited or sent over unix socket)
+		 * and attached there.
+		 *
+		 * \return True if buffer was created
+		 */
+		bool createAnonymous(void)
+		{
+			detach();
+
+			int fd = memfd_create("ringbuffer", MFD_CLOEXEC);
+
+			if(fd < 0)
+				return false;
+
+			return initialize(fd);
+		}
+
+		/*!
+		 * \brief Attach to buffer created by other process, previous mapping is detached
+		 * \param name Name of the shared memory object, as in shm_open()
+		 * \return True if header matches this instantiation and buffer was mapped
+		 */
+		bool attach(const char* name)
+		{
+			detach();
+
+			int fd = shm_open(name, O_RDWR, 0);
+
+			if(fd < 0)
+				return false;
+
+			return map(fd);
+		}
+
+		/*!
+		 * \brief Attach to buffer created by other process, previous mapping is detached
+		 * \param fd Descriptor of the shared memory, it is duplicated so caller keeps the ownership
+		 * \return True if header matches this instantiation and buffer was mapped
+		 */
+		bool attach(int fd)
+		{
+			detach();
+
+			int own_fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+
+			if(own_fd < 0)
+				return false;
+
+			return map(own_fd);
+		}
+
+		/*!
+		 * \brief Unmap shared memory, buffer is left intact for the other process
+		 */
+		void detach(void)
+		{
+			if(header != nullptr)
+				munmap(header, mapping_size);
+
+			if(shm_fd >= 0)
+				close(shm_fd);
+
+			header = nullptr;
+			rb = nullptr;
+			shm_fd = -1;
+		}
+
+		/*!
+		 * \brief Remove name of the shared memory object, memory is freed after all processes detached
+		 * \param name Name of the shared memory object, as in shm_open()
+		 * \return True if name was removed
+		 */
+		static bool unlink(const char* name) {
+			return shm_unlink(name) == 0;
+		}
+
+		/*!
+		 * \brief Get buffer placed in shared memory
+		 * \return Pointer to buffer, nullptr if not created or attached
+		 */
+		ringbuffer* get(void) const {
+			return rb;
+		}
+
+		ringbuffer* operator->(void) const {
+			return rb;
+		}
+
+		/*!
+		 * \brief Get descriptor of the shared memory
+		 * \return File descriptor, -1 if not created or attached
+		 */
+		int fd(void) const {
+			return shm_fd;
+		}
+
+	private:
+		/*!
+		 * \brief Size memory, construct buffer and publish header
+		 * \param fd Descriptor of the new shared memory object, taken over
+		 * \return True if buffer was initialized
+		 */
+		bool initialize(int fd)
+		{
+			std::atomic<index_t> probe(0);
+
+			if(!probe.is_lock_free() || ftruncate(fd, mapping_size) != 0) // locks would not be shared between processes
+			{
+				close(fd);
+				return false;
+			}
+
+			if(!mapMemory(fd))
+				return false;
+
+			rb = new(reinterpret_cast<uint8_t*>(header) + data_offset) ringbuffer();
+
+			new(header) header_t;
+			header->version = layout_version;
+			header->capacity = buffer_size;
+			header->element_size = sizeof(T);
+			header->element_alignment = alignof(T);
+			header->cacheline = cacheline_size;
+			header->index_size = sizeof(index_t);
+			header->barriers = fake_tso;
+			header->data_offset = data_offset;
+
+			header->magic.store(layout_magic, std::memory_order_release); // buffer can be attached from now on
+			return true;
+		}
+
+		/*!
+		 * \brief Map existing shared memory and validate header
+		 * \param fd Descriptor of the shared memory object, taken over
+		 * \return True if header matches this instantiation
+		 */
+		bool map(int fd)
+		{
+			struct stat st;
+
+			if(fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < mapping_size)
+			{
+				close(fd);
+				return false;
+			}
+
+			if(!mapMemory(fd))
+				return false;
+
+			if(header->magic.load(std::memory_order_acquire) != layout_magic
+				|| header->version != layout_version
+				|| header->capacity != buffer_size
+				|| header->element_size != sizeof(T)
+				|| header->element_alignment != alignof(T)
+				|| header->cacheline != cacheline_size
+				|| header->index_size != sizeof(index_t)
+				|| header->barriers != fake_tso
+				|| header->data_offset != data_offset)
+			{
+				detach();
+				return false;
+			}
+
+			rb = reinterpret_cast<ringbuffer*>(reinterpret_cast<uint8_t*>(header) + data_offset);
+			return true;
+		}
+
+		/*!
+		 * \brief Map whole layout
+		 * \param fd Descriptor of the shared memory object, taken over
+		 * \return True if memory was mapped
+		 */
+		bool mapMemory(int fd)
+		{
+			void* mem = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+			shm_fd = fd;
+
+			if(mem == MAP_FAILED)
+			{
+				detach();
+				return false;
+			}
+
+			header = static_cast<header_t*>(mem);
+			return true;
+		}
+
+		constexpr static size_t data_alignment = (alignof(ringbuffer) > alignof(header_t)) ? alignof(ringbuffer) : alignof(header_t);
+		constexpr static size_t data_offset = (sizeof(header_t) + data_alignment - 1) & ~(data_alignment - 1); //!< offset of the buffer
+		constexpr static size_t mapping_size = data_offset + sizeof(ringbuffer); //!< size of the whole layout
+
+		header_t* header; //!< beginning of the mapping
+		ringbuffer* rb; //!< buffer inside mapping
+		int shm_fd; //!< shared memory descriptor
+
+		static_assert(std::is_trivially_copyable<T>::value, "elements are shared between processes as plain memory");
+		static_assert(buffer_size != 0, "runtime sized ExternalRingbuffer keeps pointer to storage and can't be shared");
+	};
+
+} // namespace
+
+#endif //RINGBUFFER_SHM_HPP
@@ -0,0 +1,489 @@
+/*!
+ * \file ringbuffer_wait.hpp
+ * \brief Linux specific blocking and event notification wrappers for Ringbuffer
+ *
+ * \license SPDX-License-Identifier: MIT
+ */
+
+#ifndef RINGBUFFER_WAIT_HPP
+#define RINGBUFFER_WAIT_HPP
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include <atomic>
+#include <utility>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "ringbuffer_notify.hpp"
+
+namespace jnk0le
+{
+	namespace detail
+	{
+		/*!
+		 * \brief Hint to the cpu that thread is in spin wait loop
+		 */
+		inline void cpuRelax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+			__builtin_ia32_pause();
+#elif defined(__aarch64__)
+			__asm__ __volatile__("yield" ::: "memory");
+#else
+			std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+		}
+
+		/*!
+		 * \brief Futex word with spin then park wait, and wake that skips syscall when nobody sleeps on it
+		 *
+		 * Waiter raises the flag before final check of the condition, and notifier checks the flag after making
+		 * the condition true. Both sides use full fence in between, so at least one of them observes the other.
+		 */
+		class Parking
+		{
+		public:
+			Parking() : sleeping(0) {}
+
+			/*!
+			 * \brief Wait until condition is satisfied
+			 * \param ready Condition to wait for
+			 * \param spin_count Number of condition checks before parking
+			 * \param timeout_ms Maximum time to wait in milliseconds, 0 to not park at all, negative for infinite wait
+			 * \return Final result of the condition
+			 */
+			template<typename Condition>
+			bool wait(Condition ready, uint32_t spin_count, int timeout_ms)
+			{
+				for(uint32_t i = 0; i < spin_count; i++)
+				{
+					if(ready())
+						return true;
+
+					cpuRelax();
+				}
+
+				if(timeout_ms == 0)
+					return ready();
+
+				struct timespec deadline;
+
+				if(timeout_ms > 0)
+				{
+					clock_gettime(CLOCK_MONOTONIC, &deadline);
+					deadline.tv_sec += timeout_ms / 1000;
+					deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+
+					if(deadline.tv_nsec >= 1000000000L)
+					{
+						deadline.tv_sec++;
+						deadline.tv_nsec -= 1000000000L;
+					}
+				}
+
+				for(;;)
+				{
+					sleeping.store(1, std::memory_order_relaxed);
+					std::atomic_thread_fence(std::memory_order_seq_cst);
+
+					if(ready())
+						break;
+
+					struct timespec remaining;
+
+					if(timeout_ms > 0 && !remainingTime(deadline, remaining))
+					{
+						sleeping.store(0, std::memory_order_relaxed);
+						return ready();
+					}
+
+					// returns immediately if notifier already cleared the flag
+					syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sleeping), FUTEX_WAIT_PRIVATE, 1,
+							(timeout_ms > 0) ? &remaining : nullptr, nullptr, 0);
+				}
+
+				sleeping.store(0, std::memory_order_relaxed);
+				return true;
+			}
+
+			/*!
+			 * \brief Wake waiter, after condition was made true, syscall is issued only if it is parked
+			 */
+			void notify(void)
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if(sleeping.load(std::memory_order_relaxed) != 0)
+				{
+					sleeping.store(0, std::memory_order_relaxed);
+					syscall(SYS_futex, reinterpret_cast<uint32_t*>(&sleeping), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+				}
+			}
+
+		private:
+			/*!
+			 * \brief Calculate time left to the deadline
+			 * \param deadline Absolute time on monotonic clock
+			 * \param[out] remaining Relative time to deadline
+			 * \return False if deadline has passed
+			 */
+			static bool remainingTime(const struct timespec& deadline, struct timespec& remaining)
+			{
+				struct timespec now;
+				clock_gettime(CLOCK_MONOTONIC, &now);
+
+				remaining.tv_sec = deadline.tv_sec - now.tv_sec;
+				remaining.tv_nsec = deadline.tv_nsec - now.tv_nsec;
+
+				if(remaining.tv_nsec < 0)
+				{
+					remaining.tv_sec--;
+					remaining.tv_nsec += 1000000000L;
+				}
+
+				return remaining.tv_sec >= 0;
+			}
+
+			std::atomic<uint32_t> sleeping; //!< futex word, 1 when waiter is (about to be) parked
+
+			static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be plain 32 bit integer");
+		};
+
+		/*!
+		 * \brief Eventfd signalled once per armed period, so bursts of notifications produce a single event
+		 *
+		 * Waiting side arms the notifier after it observed that condition is not satisfied, first notification
+		 * after that disarms it and writes to eventfd. Arming and notification are ordered in the same way as in
+		 * Parking.
+		 */
+		class EventNotifier
+		{
+		public:
+			EventNotifier() : armed(0), event_fd(-1) {}
+			~EventNotifier() { close(); }
+
+			EventNotifier(const EventNotifier&) = delete;
+			EventNotifier& operator=(const EventNotifier&) = delete;
+
+			/*!
+			 * \brief Create eventfd, previous one is closed
+			 * \param initially_armed Signal on the first notification without arming
+			 * \return True if eventfd was created
+			 */
+			bool open(bool initially_armed)
+			{
+				close();
+				event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+				armed.store(initially_armed && event_fd >= 0, std::memory_order_relaxed);
+
+				return event_fd >= 0;
+			}
+
+			/*!
+			 * \brief Close eventfd, notifications are ignored afterwards
+			 */
+			void close(void)
+			{
+				armed.store(0, std::memory_order_relaxed);
+
+				if(event_fd >= 0)
+					::close(event_fd);
+
+				event_fd = -1;
+			}
+
+			/*!
+			 * \brief Get eventfd descriptor, to be registered for EPOLLIN
+			 * \return File descriptor, -1 if not opened
+			 */
+			int fd(void) const {
+				return event_fd;
+			}
+
+			/*!
+			 * \brief Consume pending event and arm notifier, unless condition is already satisfied
+			 * \param ready Condition that notifier signals
+			 * \return True if notifier was armed, false if condition is satisfied and should be handled now
+			 */
+			template<typename Condition>
+			bool arm(Condition ready)
+			{
+				uint64_t events;
+				ssize_t res = read(event_fd, &events, sizeof(events)); // clear level, before condition is checked
+				(void)res;
+
+				armed.store(1, std::memory_order_relaxed);
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if(ready())
+				{
+					armed.store(0, std::memory_order_relaxed);
+					return false;
+				}
+
+				return true;
+			}
+
+			/*!
+			 * \brief Signal eventfd, after condition was made true, syscall is issued only if notifier is armed
+			 */
+			void notify(void)
+			{
+				std::atomic_thread_fence(std::memory_order_seq_cst);
+
+				if(armed.load(std::memory_order_relaxed) != 0 && armed.exchange(0, std::memory_order_relaxed) != 0)
+				{
+					uint64_t event = 1;
+					ssize_t res = write(event_fd, &event, sizeof(event));
+					(void)res;
+				}
+			}
+
+		private:
+			std::atomic<uint32_t> armed; //!< 1 when next notification should signal eventfd
+			int event_fd; //!< eventfd descriptor
+		};
+	} // namespace detail
+
+	/*!
+	 * \brief SPSC ringbuffer with blocking operations, waiting side spins shortly and then parks on futex
+	 *
+	 * Every operation that makes data or space available checks whether the opposite side is parked and wakes it only
+	 * in that case, so non blocking fast path costs one fence and no syscalls.
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	class BlockingRingbuffer
+		: public detail::NotifyingRingbuffer<T, buffer_size, fake_tso, cacheline_size, index_t, detail::Parking>
+	{
+		typedef detail::NotifyingRingbuffer<T, buffer_size, fake_tso, cacheline_size, index_t, detail::Parking> notifying;
+
+	public:
+		using typename notifying::span;
+		using notifying::insert;
+		using notifying::writeBuff;
+		using notifying::remove;
+		using notifying::readBuff;
+
+		/*!
+		 * \brief Default constructor, will initialize head and tail indexes
+		 */
+		BlockingRingbuffer() : spin_count(default_spin_count) {}
+
+		/*!
+		 * \brief Set how many times condition is checked before waiting thread is parked
+		 * \param count Number of spin iterations, 0 parks immediately
+		 */
+		void setSpinCount(uint32_t count) {
+			spin_count = count;
+		}
+
+		/*!
+		 * \brief Wait on consumer side until given number of elements can be read
+		 *
+		 * Elements consumed but not yet released (see setReleaseInterval()) are released before waiting,
+		 * otherwise producer waiting for space could never be woken up.
+		 *
+		 * \param count Number of elements to wait for, must not exceed capacity
+		 * \param timeout_ms Maximum time to wait in milliseconds, 0 to spin only, negative for infinite wait
+		 * \return True if requested number of elements is available
+		 */
+		bool waitForData(size_t count = 1, int timeout_ms = -1)
+		{
+			span spans[2];
+
+			if(this->readAcquire(spans, count) >= count)
+				return true;
+
+			this->releaseTail();
+			return data_notifier.wait([&]() { return this->readAcquire(spans, count) >= count; },
+					spin_count, timeout_ms);
+		}
+
+		/*!
+		 * \brief Wait on producer side until given number of elements can be written
+		 *
+		 * Elements inserted without publishing are published before waiting, otherwise consumer waiting for data
+		 * could never be woken up.
+		 *
+		 * \param count Number of free slots to wait for, must not exceed capacity
+		 * \param timeout_ms Maximum time to wait in milliseconds, 0 to spin only, negative for infinite wait
+		 * \return True if requested number of free slots is available
+		 */
+		bool waitForSpace(size_t count = 1, int timeout_ms = -1)
+		{
+			span spans[2];
+
+			if(this->writeAcquire(spans, count) >= count)
+				return true;
+
+			this->publish();
+			return space_notifier.wait([&]() { return this->writeAcquire(spans, count) >= count; },
+					spin_count, timeout_ms);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, waiting for free slot if buffer is full
+		 * \param data element to be copied into internal buffer
+		 * \param timeout_ms Maximum time to wait in milliseconds, 0 to spin only, negative for infinite wait
+		 * \return True if data was inserted
+		 */
+		bool insertBlocking(const T& data, int timeout_ms = -1) {
+			return waitForSpace(1, timeout_ms) && insert(data);
+		}
+
+		/*!
+		 * \brief Inserts data into internal buffer, waiting for free slot if buffer is full
+		 * \param data element to be moved into internal buffer, left untouched if timed out
+		 * \param timeout_ms Maximum time to wait in milliseconds, 0 to spin only, negative for infinite wait
+		 * \return True if data was inserted
+		 */
+		bool insertBlocking(T&& data, int timeout_ms = -1) {
+			return waitForSpace(1, timeout_ms) && insert(std::move(data));
+		}
+
+		/*!
+		 * \brief Insert all elements into internal buffer, waiting for space whenever buffer gets full
+		 * \param[in] buff Pointer to buffer with data to be inserted from
+		 * \param count Number of elements to write from the given buffer
+		 * \param timeout_ms Maximum time to wait for every free slot in milliseconds, negative for infinite wait
+		 * \return Number of elements written into internal buffer, less than count only if timed out
+		 */
+		size_t writeBuffBlocking(const T* buff, size_t count, int timeout_ms = -1)
+		{
+			size_t written = 0;
+
+			while(written < count && waitForSpace(1, timeout_ms))
+				written += writeBuff(buff + written, count - written);
+
+			return written;
+		}
+
+		/*!
+		 * \brief Reads one element from internal buffer, waiting for it if buffer is empty
+		 * \param[out] data Reference to memory location where removed element will be stored
+		 * \param timeout_ms Maximum time to wait in milliseconds, 0 to spin only, negative for infinite wait
+		 * \return True if data was fetched from the internal buffer
+		 */
+		bool removeBlocking(T& data, int timeout_ms = -1) {
+			return waitForData(1, timeout_ms) && remove(&data);
+		}
+
+		/*!
+		 * \brief Load at least one element from internal buffer, waiting for data if buffer is empty
+		 * \param[out] buff Pointer to buffer where data will be loaded into
+		 * \param count Maximum number of elements to load into the given buffer
+		 * \param timeout_ms Maximum time to wait in milliseconds, 0 to spin only, negative for infinite wait
+		 * \return Number of elements that were read from internal buffer, 0 only if timed out
+		 */
+		size_t readBuffBlocking(T* buff, size_t count, int timeout_ms = -1) {
+			return waitForData(1, timeout_ms) ? readBuff(buff, count) : 0;
+		}
+
+	private:
+		constexpr static uint32_t default_spin_count = 1000; //!< spins before parking, unless changed with setSpinCount()
+
+		uint32_t spin_count; //!< number of condition checks before parking
+
+		using notifying::data_notifier;
+		using notifying::space_notifier;
+	};
+
+	/*!
+	 * \brief SPSC ringbuffer signalling eventfd on transition from empty to non empty, and optionally from full to not full
+	 *
+	 * Consumer (and producer) registers the eventfd in its epoll loop, drains the buffer on event and rearms the
+	 * notification. Until rearmed, further insertions do not touch the eventfd, so a burst causes a single wakeup.
+	 *
+	 * \code
+	 * jnk0le::EventfdRingbuffer<message, 256> rb;
+	 * rb.open();
+	 * // register rb.dataFd() for EPOLLIN
+	 *
+	 * // on EPOLLIN from rb.dataFd()
+	 * do {
+	 *     while(rb.remove(msg))
+	 *         handle(msg);
+	 * } while(!rb.armDataEvent());
+	 * \endcode
+	 *
+	 * \tparam T Type of buffered elements
+	 * \tparam buffer_size Size of the buffer. Must be a power of 2.
+	 * \tparam fake_tso Omit generation of explicit barrier code to avoid unnecesary instructions in tso scenario (e.g. simple microcontrollers/single core)
+	 * \tparam cacheline_size Size of the cache line, to insert appropriate padding in between indexes and buffer
+	 * \tparam index_t Type of array indexing type
+	 */
+	template<typename T, size_t buffer_size = 16, bool fake_tso = false, size_t cacheline_size = 0, typename index_t = size_t>
+	class EventfdRingbuffer
+		: public detail::NotifyingRingbuffer<T, buffer_size, fake_tso, cacheline_size, index_t, detail::EventNotifier>
+	{
+		typedef detail::NotifyingRingbuffer<T, buffer_size, fake_tso, cacheline_size, index_t, detail::EventNotifier> notifying;
+
+	public:
+		using typename notifying::span;
+
+		/*!
+		 * \brief Create eventfds, buffer can be used before, but there will be no events
+		 * \param space_events Create also eventfd for producer waiting for free space
+		 * \return True if all requested eventfds were created
+		 */
+		bool open(bool space_events = false)
+		{
+			bool opened = data_notifier.open(true); // buffer is assumed to be empty at this point
+
+			if(space_events)
+				opened = space_notifier.open(false) && opened;
+
+			return opened;
+		}
+
+		/*!
+		 * \brief Get eventfd signalled when data becomes available, consumer side
+		 * \return File descriptor, -1 if not opened
+		 */
+		int dataFd(void) const {
+			return data_notifier.fd();
+		}
+
+		/*!
+		 * \brief Get eventfd signalled when space becomes available, producer side
+		 * \return File descriptor, -1 if not opened with space events
+		 */
+		int spaceFd(void) const {
+			return space_notifier.fd();
+		}
+
+		/*!
+		 * \brief Clear pending data event and request next one, from consumer side
+		 * \return True if armed, false if there is data in buffer that has to be handled before going back to epoll
+		 */
+		bool armDataEvent(void) {
+			span spans[2];
+			return data_notifier.arm([&]() { return this->readAcquire(spans, 1) != 0; });
+		}
+
+		/*!
+		 * \brief Clear pending space event and request next one, from producer side
+		 * \return True if armed, false if there is free space in buffer that can be used before going back to epoll
+		 */
+		bool armSpaceEvent(void) {
+			span spans[2];
+			return space_notifier.arm([&]() { return this->writeAcquire(spans, 1) != 0; });
+		}
+
+	private:
+		using notifying::data_notifier;
+		using notifying::space_notifier;
+	};
+
+} // namespace
+
+#endif //RINGBUFFER_WAIT_HPP